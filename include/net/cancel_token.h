@@ -0,0 +1,23 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace net {
+
+// Cancellation signal of a request: set when the requester cancels it or
+// the deadline it sent has passed. A default-constructed token never
+// expires.
+struct cancel_token {
+  bool cancelled() const {
+    return (cancelled_ != nullptr && cancelled_->load()) ||
+           std::chrono::steady_clock::now() >= deadline_;
+  }
+
+  std::shared_ptr<std::atomic_bool> cancelled_;
+  std::chrono::steady_clock::time_point deadline_{
+      std::chrono::steady_clock::time_point::max()};
+};
+
+}  // namespace net
@@ -0,0 +1,106 @@
+#ifndef NET_DNS_CACHE_H_
+#define NET_DNS_CACHE_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "boost/asio.hpp"
+
+namespace net {
+
+struct dns_cache_settings {
+  // Lifetime of successful lookups. The system resolver (getaddrinfo) does
+  // not report record TTLs, so this is configured instead.
+  std::chrono::seconds ttl_{60};
+
+  // Lifetime of "host not found" / "no data" results.
+  std::chrono::seconds negative_ttl_{5};
+
+  // Entries used this close to expiry are refreshed in the background while
+  // the cached addresses are still handed out.
+  std::chrono::seconds refresh_ahead_{10};
+
+  // Outstanding lookups (each one occupies a resolver thread). Further
+  // lookups wait.
+  std::size_t max_concurrent_lookups_{8U};
+
+  // A lookup runs on the executor of the caller that started it. If it has
+  // not completed after this long (e.g. because that io_context was
+  // stopped), its slot is freed and the next caller starts a new lookup.
+  std::chrono::seconds lookup_timeout_{30};
+
+  // Expired entries are dropped once the cache holds more entries.
+  std::size_t max_entries_{1024U};
+};
+
+// Asynchronous host:port -> endpoints cache shared by client connections.
+// Concurrent lookups of the same name are coalesced into one.
+class dns_cache : public std::enable_shared_from_this<dns_cache> {
+public:
+  typedef std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+  typedef std::function<void(boost::system::error_code, endpoints)> callback;
+
+  explicit dns_cache(dns_cache_settings settings = dns_cache_settings{});
+
+  // Process-wide default cache (used by net::tcp and net::ssl).
+  static std::shared_ptr<dns_cache> const& shared();
+
+  // The callback is always invoked through `executor`, never inline.
+  void resolve(boost::asio::any_io_executor const& executor,
+               std::string const& host, std::string const& port,
+               callback cb);
+
+private:
+  typedef std::chrono::steady_clock clock;
+
+  struct waiter {
+    boost::asio::any_io_executor executor_;
+    callback cb_;
+  };
+
+  struct entry {
+    bool valid_{false}, resolving_{false};
+    std::uint64_t lookup_{0U};  // id of the current lookup
+    clock::time_point lookup_started_;
+    boost::system::error_code ec_;
+    endpoints endpoints_;
+    clock::time_point expires_;
+    std::vector<waiter> waiting_;
+  };
+
+  struct lookup {
+    std::uint64_t id_;
+    boost::asio::any_io_executor executor_;
+    std::string key_, host_, port_;
+  };
+
+  bool stalled(entry const&, clock::time_point now) const;
+  lookup begin_lookup(entry&, boost::asio::any_io_executor const&,
+                      std::string const& key, std::string const& host,
+                      std::string const& port, clock::time_point now);
+  void start(lookup l);
+  void schedule(clock::time_point now, std::vector<lookup>& ready);
+  void run(lookup l);
+  void on_resolved(lookup const& l, boost::system::error_code ec,
+                   endpoints eps);
+  void prune(clock::time_point now);
+
+  dns_cache_settings settings_;
+  std::mutex mutex_;
+  std::map<std::string, entry> entries_;
+  std::deque<lookup> queued_;
+  std::map<std::uint64_t, clock::time_point> running_;  // id -> started
+  std::uint64_t next_lookup_{0U};
+};
+
+}  // namespace net
+
+#endif  // NET_DNS_CACHE_H_
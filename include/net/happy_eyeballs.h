@@ -0,0 +1,61 @@
+#ifndef NET_HAPPY_EYEBALLS_H_
+#define NET_HAPPY_EYEBALLS_H_
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "boost/asio.hpp"
+
+#include "net/dns_cache.h"
+
+namespace net {
+
+// Connection racing over all resolved addresses (RFC 8305 "Happy
+// Eyeballs"): address families are interleaved, a new attempt starts every
+// `attempt_delay` (or as soon as the previous one fails) and the first
+// established connection wins. A blackholed address only costs the delay
+// instead of the whole connect timeout.
+class happy_eyeballs : public std::enable_shared_from_this<happy_eyeballs> {
+public:
+  typedef std::function<void(boost::system::error_code,
+                             boost::asio::ip::tcp::socket)>
+      callback;
+
+  static constexpr auto const kAttemptDelay = std::chrono::milliseconds{250};
+
+  // The callback is invoked exactly once (never inline).
+  static std::shared_ptr<happy_eyeballs> connect(
+      boost::asio::any_io_executor const& executor,
+      dns_cache::endpoints const& endpoints, callback cb,
+      std::chrono::milliseconds attempt_delay = kAttemptDelay);
+
+  happy_eyeballs(boost::asio::any_io_executor const& executor,
+                 dns_cache::endpoints endpoints, callback cb,
+                 std::chrono::milliseconds attempt_delay);
+
+  // Aborts all attempts (callback: operation_aborted).
+  void cancel();
+
+private:
+  void start_next();
+  void on_connect(std::size_t i, boost::system::error_code const& ec);
+  void finish(boost::system::error_code ec, boost::asio::ip::tcp::socket s);
+  void close_all();
+
+  boost::asio::any_io_executor executor_;
+  dns_cache::endpoints endpoints_;
+  callback cb_;
+  std::chrono::milliseconds attempt_delay_;
+  boost::asio::steady_timer timer_;
+  std::vector<std::unique_ptr<boost::asio::ip::tcp::socket>> sockets_;
+  std::size_t pending_{0U};
+  bool done_{false};
+  boost::system::error_code last_ec_;
+};
+
+}  // namespace net
+
+#endif  // NET_HAPPY_EYEBALLS_H_
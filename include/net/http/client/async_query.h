@@ -0,0 +1,114 @@
+#ifndef NET_HTTP_CLIENT_ASYNC_QUERY_H_
+#define NET_HTTP_CLIENT_ASYNC_QUERY_H_
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "boost/asio/associated_cancellation_slot.hpp"
+#include "boost/asio/associated_executor.hpp"
+#include "boost/asio/async_result.hpp"
+#include "boost/asio/cancellation_type.hpp"
+#include "boost/asio/executor_work_guard.hpp"
+#include "boost/asio/post.hpp"
+
+#include "net/http/client/connection_pool.h"
+
+namespace net {
+namespace http {
+namespace client {
+
+namespace detail {
+
+template <typename Handler>
+struct async_query_op {
+  using executor_type =
+      boost::asio::associated_executor_t<Handler,
+                                         boost::asio::any_io_executor>;
+
+  async_query_op(Handler&& handler, executor_type const& executor)
+      : handler_(std::move(handler)),
+        work_(boost::asio::make_work_guard(executor)) {}
+
+  // First call wins: the query result or the cancellation. The slot is
+  // cleared on the handler's executor, where cancellations are emitted.
+  void complete(boost::system::error_code const ec, response res) {
+    if (completed_.exchange(true)) {
+      return;
+    }
+    auto const executor = work_.get_executor();
+    work_.reset();
+    boost::asio::post(
+        executor, [h = std::move(*handler_), ec,
+                   res = std::move(res)]() mutable {
+          boost::asio::get_associated_cancellation_slot(h).clear();
+          std::move(h)(ec, std::move(res));
+        });
+  }
+
+  std::optional<Handler> handler_;
+  boost::asio::executor_work_guard<executor_type> work_;
+  std::atomic_bool completed_{false};
+};
+
+}  // namespace detail
+
+// Asynchronous query through a connection pool, usable with any completion
+// token. With `boost::asio::use_awaitable`:
+//
+//   auto const res = co_await async_query(pool, req, use_awaitable);
+//
+// Completion signature: void(boost::system::error_code, response).
+// Supports per-operation cancellation (the connection running the query is
+// closed, a waiting query is dropped).
+template <typename CompletionToken>
+auto async_query(connection_pool& pool, request req, CompletionToken&& token) {
+  return boost::asio::async_initiate<CompletionToken,
+                                     void(boost::system::error_code,
+                                          response)>(
+      [&pool](auto handler, request req) {
+        using handler_t = decltype(handler);
+        auto const pool_executor = pool.get_executor();
+        auto const executor = boost::asio::get_associated_executor(
+            handler, boost::asio::any_io_executor{pool_executor});
+        auto slot = boost::asio::get_associated_cancellation_slot(handler);
+        auto const op = std::make_shared<detail::async_query_op<handler_t>>(
+            std::move(handler), executor);
+        auto const handle = std::make_shared<query_handle>();
+
+        if (slot.is_connected()) {
+          slot.assign(
+              [op, handle, pool_executor](boost::asio::cancellation_type) {
+                // Runs where the cancellation was emitted: abort the query
+                // on the pool's thread.
+                boost::asio::post(pool_executor,
+                                  [handle]() { handle->cancel(); });
+                op->complete(boost::asio::error::operation_aborted,
+                             {0, {}, ""});
+              });
+        }
+
+        // The pool (and the handle) may only be used from its own thread.
+        boost::asio::post(pool_executor, [p = pool.shared_from_this(), op,
+                                          handle,
+                                          req = std::move(req)]() mutable {
+          if (op->completed_) {
+            return;  // cancelled before it started
+          }
+          p->query(
+              std::move(req),
+              [op](response res, boost::system::error_code ec) {
+                op->complete(ec, std::move(res));
+              },
+              handle);
+        });
+      },
+      token, std::move(req));
+}
+
+}  // namespace client
+}  // namespace http
+}  // namespace net
+
+#endif  // NET_HTTP_CLIENT_ASYNC_QUERY_H_
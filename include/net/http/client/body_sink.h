@@ -0,0 +1,25 @@
+#ifndef NET_HTTP_CLIENT_BODY_SINK_H_
+#define NET_HTTP_CLIENT_BODY_SINK_H_
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace net {
+namespace http {
+namespace client {
+
+// Receives the (decoded) response body chunk by chunk instead of
+// response::body, followed by an empty chunk at the end of the body.
+// Returning false aborts the query (errc::io_error).
+typedef std::function<bool(std::string_view)> body_sink;
+
+// Writes the response body to a file (truncated first, flushed at the end
+// of the body).
+body_sink file_sink(std::string const& path);
+
+}  // namespace client
+}  // namespace http
+}  // namespace net
+
+#endif  // NET_HTTP_CLIENT_BODY_SINK_H_
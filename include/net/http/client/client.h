@@ -1,17 +1,22 @@
 #ifndef NET_HTTP_CLIENT_CLIENT_H_
 #define NET_HTTP_CLIENT_CLIENT_H_
 
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "boost/asio.hpp"
+#include "boost/beast/core/flat_buffer.hpp"
+#include "boost/beast/http/parser.hpp"
 #include "boost/date_time/posix_time/posix_time.hpp"
-#include "boost/iostreams/stream.hpp"
 #include "boost/system/error_code.hpp"
 
+#include "net/http/client/body_sink.h"
+#include "net/http/client/inflating_body.h"
 #include "net/http/client/request.h"
 #include "net/http/client/response.h"
 #include "net/http/client/url.h"
@@ -25,9 +30,6 @@ namespace client {
 template <typename C>
 class basic_http_client : public C, boost::asio::coroutine {
 public:
-  typedef char char_type;
-  typedef boost::iostreams::source_tag category;
-
   typedef std::function<void(std::shared_ptr<C>, response,
                              boost::system::error_code)>
       callback;
@@ -38,7 +40,21 @@ public:
 
   void query(request& req, callback cb);
 
-  std::streamsize read(char_type* s, std::streamsize n);
+  // Pipelined queries (HTTP/1.1): all requests are written at once, the
+  // responses are read in order and passed to `on_response` with the
+  // request index. `done` receives the number of answered requests; the
+  // remaining ones were not answered (error or the server closed the
+  // connection) and have to be sent again. Idempotent requests only.
+  typedef std::function<void(std::size_t, response)> batch_response_cb;
+  typedef std::function<void(std::shared_ptr<C>, std::size_t,
+                             boost::system::error_code)>
+      batch_done_cb;
+  void pipeline(std::vector<request> const& reqs, batch_response_cb on_response,
+                batch_done_cb done);
+
+  // True if the connection can be reused for the next query:
+  // still connected and the server did not ask to close it.
+  bool keep_alive() const;
 
 protected:
   void on_connect(callback cb, std::shared_ptr<C> self,
@@ -52,17 +68,24 @@ protected:
 
   void read_header();
 
-  void read_content_length();
+  void read_pipelined(std::shared_ptr<C> self, std::size_t i,
+                      std::shared_ptr<batch_response_cb> on_response,
+                      std::shared_ptr<batch_done_cb> done);
+
+  struct body_options {
+    body_sink sink_;
+    std::uint64_t max_size_;
+  };
 
-  std::size_t copy_content(std::size_t buffer_size);
+  void prepare_parser(body_options const&);
 
   std::string request_;
-  boost::asio::streambuf buf_;
-  std::istream response_stream_;
+  body_options body_;
+  std::vector<body_options> batch_;
+  boost::beast::flat_buffer buf_;
+  std::optional<boost::beast::http::response_parser<inflating_body>> parser_;
   int status_code_;
-  std::size_t length_;
   std::map<std::string, std::string> header_;
-  std::vector<char> response_;
 };
 
 }  // namespace client
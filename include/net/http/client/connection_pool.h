@@ -0,0 +1,156 @@
+#ifndef NET_HTTP_CLIENT_CONNECTION_POOL_H_
+#define NET_HTTP_CLIENT_CONNECTION_POOL_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/asio.hpp"
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+#include "boost/system/error_code.hpp"
+
+#include "net/http/client/client.h"
+#include "net/http/client/request.h"
+#include "net/http/client/response.h"
+#include "net/ssl.h"
+#include "net/tcp.h"
+
+namespace net {
+namespace http {
+namespace client {
+
+struct pool_settings {
+  // Connections per host (idle and busy). Further queries wait.
+  std::size_t max_per_host_{16U};
+
+  // Idle keep-alive connections kept per host.
+  std::size_t max_idle_per_host_{4U};
+
+  // Idle connections older than this are closed instead of reused.
+  boost::posix_time::time_duration idle_timeout_{
+      boost::posix_time::seconds(30)};
+
+  // Timeout per query (connect + transfer).
+  boost::posix_time::time_duration timeout_{DEFAULT_TIMEOUT};
+
+  // Requests sent at once on one connection by query_pipelined().
+  std::size_t max_pipeline_depth_{8U};
+};
+
+// Aborts a query started with a handle (see connection_pool::query): a
+// waiting query is dropped, a running query closes its connection. The
+// callback receives operation_aborted unless the query finished first.
+// Thread-safe like the pool: cancel() may be called from any thread.
+class query_handle {
+public:
+  void cancel();
+  bool cancelled() const { return cancelled_; }
+
+private:
+  friend class connection_pool;
+
+  // Replaces the abort action. Returns false (and drops it) if the handle
+  // is cancelled already.
+  bool set_abort(std::function<void()>);
+
+  std::atomic_bool cancelled_{false};
+  std::mutex mutex_;
+  std::function<void()> abort_;
+};
+
+// Keep-alive connections shared across queries, keyed by host and port.
+// Idle connections are checked before reuse (closed by the peer, unexpected
+// data, idle timeout). A query that fails on a reused connection is retried
+// once on a new connection.
+class connection_pool : public std::enable_shared_from_this<connection_pool> {
+public:
+  typedef std::function<void(response, boost::system::error_code)> callback;
+
+  explicit connection_pool(boost::asio::io_context& ios,
+                           pool_settings settings = pool_settings{});
+
+  void query(request req, callback cb,
+             std::shared_ptr<query_handle> handle = nullptr);
+
+  // Sends the requests pipelined (HTTP/1.1): idempotent requests to the same
+  // host are written in batches of max_pipeline_depth_ on one connection.
+  // Requests left unanswered when the server closes the connection are sent
+  // again individually, as are non-idempotent requests and requests with a
+  // response sink or size limit. The callback is called once per request
+  // (with its index), in no particular order.
+  typedef std::function<void(std::size_t, response, boost::system::error_code)>
+      batch_callback;
+  void query_pipelined(std::vector<request> reqs, batch_callback cb);
+
+  boost::asio::io_context::executor_type get_executor() const {
+    return ios_.get_executor();
+  }
+
+private:
+  struct waiting_query {
+    request req_;
+    callback cb_;
+    std::shared_ptr<query_handle> handle_;
+  };
+
+  template <typename C>
+  struct host_state {
+    struct idle_connection {
+      std::shared_ptr<basic_http_client<C>> client_;
+      std::chrono::steady_clock::time_point since_;
+    };
+
+    std::vector<idle_connection> idle_;
+    std::size_t busy_{0U};
+    std::deque<waiting_query> waiting_;
+  };
+
+  template <typename C>
+  void query(request req, callback cb, std::shared_ptr<query_handle> handle,
+             bool allow_reuse);
+
+  template <typename C>
+  void run(std::shared_ptr<basic_http_client<C>> client, request req,
+           callback cb, std::shared_ptr<query_handle> handle, bool reused);
+
+  typedef std::vector<std::pair<std::size_t, request>> batch;
+
+  template <typename C>
+  void pipeline(batch b, std::shared_ptr<batch_callback> cb);
+
+  template <typename C>
+  void drop_cancelled(std::string const& key);
+
+  template <typename C>
+  void release(std::string const& key,
+               std::shared_ptr<basic_http_client<C>> const& client,
+               bool reusable);
+
+  template <typename C>
+  host_state<C>& host(std::string const& key);
+
+  boost::asio::io_context& ios_;
+  pool_settings settings_;
+  std::mutex mutex_;
+  std::map<std::string, host_state<tcp>> http_hosts_;
+  std::map<std::string, host_state<ssl>> https_hosts_;
+};
+
+template <typename... Args>
+std::shared_ptr<connection_pool> make_connection_pool(Args&&... args) {
+  return std::make_shared<connection_pool>(std::forward<Args>(args)...);
+}
+
+}  // namespace client
+}  // namespace http
+}  // namespace net
+
+#endif  // NET_HTTP_CLIENT_CONNECTION_POOL_H_
@@ -0,0 +1,55 @@
+#ifndef NET_HTTP_CLIENT_FAN_OUT_H_
+#define NET_HTTP_CLIENT_FAN_OUT_H_
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "boost/asio/awaitable.hpp"
+#include "boost/system/error_code.hpp"
+
+#include "net/http/client/connection_pool.h"
+#include "net/http/client/request.h"
+#include "net/http/client/response.h"
+
+namespace net {
+namespace http {
+namespace client {
+
+struct fan_out_settings {
+  // Queries running at the same time (all hosts).
+  std::size_t max_concurrent_{16U};
+
+  // Queries running at the same time per host:port.
+  std::size_t max_per_host_{4U};
+
+  // Cancels all queries still running or waiting after this time
+  // (0 = no deadline).
+  std::chrono::milliseconds deadline_{0};
+
+  // Cancels the remaining queries after the first failed one (transport
+  // error; HTTP error statuses do not count).
+  bool cancel_on_failure_{true};
+};
+
+// Called once per request (in the order the queries finish) with the index
+// of the request. Cancelled queries report operation_aborted.
+typedef std::function<void(std::size_t, response, boost::system::error_code)>
+    fan_out_callback;
+
+// Runs all requests through the pool, respecting the concurrency limits.
+// Returns the error that stopped the fan-out (first failure with
+// `cancel_on_failure_`, timed_out at the deadline, operation_aborted when
+// the coroutine is cancelled) or success. An exception thrown by
+// `on_result` stops the fan-out and is rethrown. Either way, fan_out
+// returns only after all running queries have finished.
+boost::asio::awaitable<boost::system::error_code> fan_out(
+    connection_pool& pool, std::vector<request> requests,
+    fan_out_callback on_result, fan_out_settings settings = fan_out_settings{});
+
+}  // namespace client
+}  // namespace http
+}  // namespace net
+
+#endif  // NET_HTTP_CLIENT_FAN_OUT_H_
@@ -0,0 +1,156 @@
+#ifndef NET_HTTP_CLIENT_HTTP_CACHE_H_
+#define NET_HTTP_CLIENT_HTTP_CACHE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "net/http/client/connection_pool.h"
+#include "net/http/client/request.h"
+#include "net/http/client/response.h"
+
+namespace net {
+namespace http {
+namespace client {
+
+struct http_cache_settings {
+  // Bodies kept in memory (all entries together).
+  std::size_t max_memory_bytes_{64U * 1024U * 1024U};
+
+  // Larger responses are not cached.
+  std::size_t max_entry_bytes_{8U * 1024U * 1024U};
+
+  // Entries evicted from memory are moved to files in this directory
+  // (empty: memory only). The files are removed with the cache.
+  std::string disk_dir_;
+  std::size_t max_disk_bytes_{512U * 1024U * 1024U};
+};
+
+struct http_cache_stats {
+  std::atomic_uint64_t hits_{0U};
+  std::atomic_uint64_t revalidated_{0U};  // 304 Not Modified
+  std::atomic_uint64_t misses_{0U};
+  std::atomic_uint64_t stored_{0U};
+};
+
+// Private (single client) HTTP cache for GET responses, keyed by URL and
+// the request headers named in Vary. Freshness from Cache-Control max-age,
+// Expires or (heuristically) Last-Modified; stale entries with an ETag or
+// Last-Modified are revalidated. Thread-safe.
+class http_cache {
+public:
+  typedef std::chrono::steady_clock::time_point time_point;
+
+  struct cached {
+    response res_;
+    bool fresh_;
+    std::string etag_, last_modified_;
+  };
+
+  explicit http_cache(http_cache_settings settings = http_cache_settings{});
+  ~http_cache();
+
+  http_cache(http_cache const&) = delete;
+  http_cache& operator=(http_cache const&) = delete;
+
+  std::optional<cached> get(request const& req, time_point now);
+
+  // Stores (or replaces) the response if it is cacheable.
+  // `sent`: when the request was sent (for the age of the response).
+  void put(request const& req, response const& res, time_point sent);
+
+  // Merges the headers of a 304 response into the entry and returns the
+  // refreshed response (nothing if the entry is gone in the meantime).
+  std::optional<response> update(request const& req,
+                                 response const& not_modified,
+                                 time_point sent);
+
+  // Drops all variants of the URL.
+  void invalidate(url const& u);
+
+  http_cache_stats& stats() { return stats_; }
+
+private:
+  struct entry {
+    std::string url_;
+    std::vector<std::pair<std::string, std::string>> vary_;
+    int status_code_;
+    std::map<std::string, std::string> headers_;
+    std::shared_ptr<std::string const> body_;  // null if only on disk
+    std::string file_;  // set if the body was moved to disk
+    std::size_t size_;
+    time_point expires_;
+    bool revalidate_;
+  };
+  typedef std::list<entry>::iterator entry_it;
+
+  // File written when an entry is moved to disk. The entry keeps its body
+  // until the file is complete.
+  struct spill {
+    std::string url_, file_;
+    std::shared_ptr<std::string const> body_;
+  };
+
+  std::optional<entry_it> find(request const& req);
+  std::optional<entry_it> find_file(std::string const& url,
+                                    std::string const& file);
+  std::optional<entry_it> find_in_memory(request const& req,
+                                         std::unique_lock<std::mutex>& lock);
+  void erase(entry_it it);
+  void touch(entry_it it);
+  void evict();
+  void flush_io(std::unique_lock<std::mutex>& lock);
+
+  http_cache_settings settings_;
+  http_cache_stats stats_;
+
+  std::mutex mutex_;
+  std::list<entry> memory_, disk_;  // most recently used first
+  std::map<std::string, std::vector<entry_it>> index_;  // by URL
+  std::size_t memory_bytes_{0U}, disk_bytes_{0U};
+  std::uint64_t next_file_{0U};
+
+  // File I/O queued while holding mutex_, done by flush_io() without it.
+  std::vector<spill> spills_;
+  std::vector<std::string> unlinked_;
+};
+
+// Runs GET queries through the cache: fresh entries are answered without a
+// request, stale entries are revalidated (If-None-Match/If-Modified-Since).
+// Other methods invalidate the URL. Requests with a response sink, their
+// own conditional headers or Cache-Control: no-store bypass the cache.
+class caching_client : public std::enable_shared_from_this<caching_client> {
+public:
+  typedef connection_pool::callback callback;
+
+  caching_client(std::shared_ptr<connection_pool> pool,
+                 std::shared_ptr<http_cache> cache);
+
+  void query(request req, callback cb);
+
+  http_cache& cache() { return *cache_; }
+
+private:
+  std::shared_ptr<connection_pool> pool_;
+  std::shared_ptr<http_cache> cache_;
+};
+
+template <typename... Args>
+std::shared_ptr<caching_client> make_caching_client(Args&&... args) {
+  return std::make_shared<caching_client>(std::forward<Args>(args)...);
+}
+
+}  // namespace client
+}  // namespace http
+}  // namespace net
+
+#endif  // NET_HTTP_CLIENT_HTTP_CACHE_H_
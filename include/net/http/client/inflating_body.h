@@ -0,0 +1,256 @@
+#ifndef NET_HTTP_CLIENT_INFLATING_BODY_H_
+#define NET_HTTP_CLIENT_INFLATING_BODY_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "boost/asio/buffer.hpp"
+#include "boost/beast/core/string.hpp"
+#include "boost/beast/http/error.hpp"
+#include "boost/beast/http/field.hpp"
+#include "boost/beast/http/fields.hpp"
+#include "boost/beast/http/message.hpp"
+#include "boost/optional.hpp"
+#include "boost/system/error_code.hpp"
+
+#include "zlib.h"
+
+#include "net/http/client/body_sink.h"
+
+namespace net {
+namespace http {
+namespace client {
+
+// String body that decodes gzip / deflate (zlib or raw) content encodings
+// while the body is being read. The body is stored once: identity content goes
+// straight into the (preallocated) string, compressed content is inflated
+// chunk by chunk without keeping the compressed bytes. With a sink, the
+// decoded chunks are passed on instead of being stored.
+struct inflating_body {
+  struct value_type {
+    std::string data_;
+    body_sink sink_;
+
+    // Limit of the decoded body size (error: body_limit).
+    std::uint64_t max_size_{std::numeric_limits<std::uint64_t>::max()};
+  };
+
+  static std::uint64_t size(value_type const& body) {
+    return body.data_.size();
+  }
+
+  class reader {
+  public:
+    template <bool IsRequest, class Fields>
+    reader(boost::beast::http::header<IsRequest, Fields>& h, value_type& body)
+        : fields_(h), body_(body) {}
+
+    reader(reader const&) = delete;
+    reader& operator=(reader const&) = delete;
+
+    ~reader() {
+      if (initialized_) {
+        inflateEnd(&zs_);
+      }
+    }
+
+    void init(boost::optional<std::uint64_t> const& content_length,
+              boost::beast::error_code& ec) {
+      ec = {};
+
+      // The header is complete now (it is not when the reader is created).
+      auto const encoding =
+          fields_[boost::beast::http::field::content_encoding];
+      deflate_ = boost::beast::iequals(encoding, "deflate");
+      inflate_ = deflate_ || boost::beast::iequals(encoding, "gzip") ||
+                 boost::beast::iequals(encoding, "x-gzip");
+
+      if (content_length.has_value()) {
+        if (!inflate_ && *content_length > body_.max_size_) {
+          ec = boost::beast::http::error::body_limit;
+          return;
+        }
+        // Content-Length comes from the server: the string grows beyond
+        // kMaxReserve as the data actually arrives.
+        if (!body_.sink_) {
+          body_.data_.reserve(static_cast<std::size_t>(std::min(
+              {*content_length, body_.max_size_, kMaxReserve})));
+        }
+      }
+      if (inflate_) {
+        // 32: detect gzip and zlib headers automatically.
+        initialized_ = inflateInit2(&zs_, MAX_WBITS + 32) == Z_OK;
+        if (!initialized_) {
+          ec = boost::beast::http::error::bad_transfer_encoding;
+        }
+      }
+    }
+
+    template <class ConstBufferSequence>
+    std::size_t put(ConstBufferSequence const& buffers,
+                    boost::beast::error_code& ec) {
+      ec = {};
+      auto n = std::size_t{0U};
+      for (auto it = boost::asio::buffer_sequence_begin(buffers);
+           it != boost::asio::buffer_sequence_end(buffers); ++it) {
+        auto const b = boost::asio::const_buffer{*it};
+        if (b.size() == 0U) {
+          continue;
+        }
+        if (inflate_) {
+          inflate(b, ec);
+        } else {
+          write(static_cast<char const*>(b.data()), b.size(), ec);
+        }
+        if (ec) {
+          return n;
+        }
+        n += b.size();
+      }
+      return n;
+    }
+
+    void finish(boost::beast::error_code& ec) {
+      ec = {};
+      if (inflate_ && !done_) {
+        ec = boost::beast::http::error::partial_message;
+      } else if (body_.sink_ && !body_.sink_({})) {
+        ec = sink_error();
+      }
+    }
+
+  private:
+    static constexpr auto const kMaxReserve = std::uint64_t{1024U * 1024U};
+
+    // Counts `size` more decoded bytes against the limit.
+    bool admit(std::size_t const size, boost::beast::error_code& ec) {
+      if (size > body_.max_size_ - written_) {
+        ec = boost::beast::http::error::body_limit;
+        return false;
+      }
+      written_ += size;
+      return true;
+    }
+
+    // Never called with size 0: an empty chunk ends the body for the sink.
+    void write(char const* data, std::size_t const size,
+               boost::beast::error_code& ec) {
+      if (!admit(size, ec)) {
+        return;
+      }
+      if (!body_.sink_) {
+        body_.data_.append(data, size);
+      } else if (!body_.sink_({data, size})) {
+        ec = sink_error();
+      }
+    }
+
+    void inflate(boost::asio::const_buffer const& b,
+                 boost::beast::error_code& ec) {
+      if (done_) {
+        return;  // trailing garbage after the end of the stream
+      }
+
+      // Input before this buffer, its first bytes are kept in head_ for a
+      // retry as raw deflate.
+      auto const earlier = seen_;
+      seen_ += b.size();
+      if (!raw_ && head_size_ != head_.size()) {
+        auto const n = std::min(head_.size() - head_size_, b.size());
+        std::copy_n(static_cast<char const*>(b.data()), n,
+                    head_.data() + head_size_);
+        head_size_ += n;
+      }
+
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+      zs_.next_in = static_cast<Bytef*>(const_cast<void*>(b.data()));
+      zs_.avail_in = static_cast<uInt>(b.size());
+      while (zs_.avail_in != 0U && !done_) {
+        // Without a sink: inflate straight into the body string.
+        auto const direct = !body_.sink_;
+        auto const offset = body_.data_.size();
+        auto const capacity =
+            direct ? std::max(std::size_t{16U * 1024U},
+                              std::size_t{zs_.avail_in} * 4U)
+                   : chunk_.size();
+        if (direct) {
+          body_.data_.resize(offset + capacity);
+        }
+        auto const out = direct ? &body_.data_[offset] : chunk_.data();
+        zs_.next_out = reinterpret_cast<Bytef*>(out);
+        zs_.avail_out = static_cast<uInt>(capacity);
+
+        auto const ret = ::inflate(&zs_, Z_NO_FLUSH);
+        auto const produced = capacity - zs_.avail_out;
+        if (direct) {
+          body_.data_.resize(offset + produced);
+        }
+
+        if (ret == Z_DATA_ERROR && deflate_ && !raw_ &&
+            zs_.total_out == 0U && earlier <= head_.size()) {
+          // "Content-Encoding: deflate" without zlib header (as sent by
+          // some servers): start over as raw deflate.
+          return inflate_raw(b, earlier, ec);
+        }
+        if (ret == Z_STREAM_END) {
+          done_ = true;
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+          ec = boost::beast::http::error::bad_transfer_encoding;
+          return;
+        }
+
+        if (direct) {
+          admit(produced, ec);
+        } else if (produced != 0U) {
+          write(out, produced, ec);
+        }
+        if (ec) {
+          return;
+        }
+      }
+    }
+
+    void inflate_raw(boost::asio::const_buffer const& b,
+                     std::uint64_t const earlier,
+                     boost::beast::error_code& ec) {
+      raw_ = true;
+      seen_ = 0U;
+      if (inflateReset2(&zs_, -MAX_WBITS) != Z_OK) {
+        ec = boost::beast::http::error::bad_transfer_encoding;
+        return;
+      }
+      auto const head = head_;
+      if (earlier != 0U) {
+        inflate(boost::asio::buffer(head.data(), earlier), ec);
+      }
+      if (!ec) {
+        inflate(b, ec);
+      }
+    }
+
+    static boost::beast::error_code sink_error() {
+      return boost::system::errc::make_error_code(
+          boost::system::errc::io_error);
+    }
+
+    boost::beast::http::fields const& fields_;
+    value_type& body_;
+    std::uint64_t written_{0U};
+    std::array<char, 16U * 1024U> chunk_;
+    z_stream zs_{};
+    bool inflate_{false}, initialized_{false}, done_{false};
+    bool deflate_{false}, raw_{false};
+    std::uint64_t seen_{0U};  // compressed bytes
+    std::array<char, 2U> head_{};  // zlib fails at most 2 bytes in
+    std::size_t head_size_{0U};
+  };
+};
+
+}  // namespace client
+}  // namespace http
+}  // namespace net
+
+#endif  // NET_HTTP_CLIENT_INFLATING_BODY_H_
@@ -1,10 +1,13 @@
 #ifndef NET_HTTP_CLIENT_REQUEST_H_
 #define NET_HTTP_CLIENT_REQUEST_H_
 
+#include <cstdint>
+#include <limits>
 #include <map>
 #include <optional>
 #include <string>
 
+#include "net/http/client/body_sink.h"
 #include "net/http/client/url.h"
 
 namespace net {
@@ -33,6 +36,13 @@ public:
   method req_method;
   std::map<std::string, std::string> headers;
   std::string body;
+
+  // Streams the response body instead of collecting it in response::body.
+  body_sink response_sink;
+
+  // Fails the query (beast::http::error::body_limit) if the decoded
+  // response body gets larger.
+  std::uint64_t max_response_size = std::numeric_limits<std::uint64_t>::max();
 };
 
 char const* method_to_str(request::method);
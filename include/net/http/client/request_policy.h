@@ -0,0 +1,109 @@
+#ifndef NET_HTTP_CLIENT_REQUEST_POLICY_H_
+#define NET_HTTP_CLIENT_REQUEST_POLICY_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "boost/asio.hpp"
+
+#include "net/http/client/connection_pool.h"
+#include "net/http/client/request.h"
+#include "net/http/client/response.h"
+
+namespace net {
+namespace http {
+namespace client {
+
+// Retries and hedging apply to idempotent requests (not POST/CONNECT)
+// without a response sink only.
+struct request_policy {
+  // Attempts per query including retries and the hedged attempt.
+  unsigned max_attempts_{3U};
+
+  // Delay before a retry: doubles per retry up to max_backoff_, jittered
+  // (uniformly from half to the full delay).
+  std::chrono::milliseconds backoff_{50};
+  std::chrono::milliseconds max_backoff_{1000};
+
+  // Retry 502, 503 and 504 responses like transport errors.
+  bool retry_unavailable_{true};
+
+  // Sends a second attempt if the first one takes longer than the
+  // hedge_percentile_ latency of recent queries to the same host (no
+  // hedging before min_samples_ latencies are known).
+  bool hedge_{true};
+  double hedge_percentile_{0.95};
+  std::chrono::milliseconds min_hedge_delay_{5};
+  std::size_t min_samples_{16U};
+
+  // Overall budget per query, retries and hedges included (0 = none).
+  std::chrono::milliseconds deadline_{10000};
+};
+
+struct request_policy_stats {
+  std::atomic_uint64_t queries_{0U};
+  std::atomic_uint64_t retries_{0U};
+  std::atomic_uint64_t hedges_fired_{0U};
+  std::atomic_uint64_t hedges_won_{0U};
+  std::atomic_uint64_t deadlines_exceeded_{0U};
+};
+
+// Runs queries through a connection pool with retries, hedging and a
+// deadline according to the policy. The first successful attempt wins,
+// the others are cancelled.
+class policy_client : public std::enable_shared_from_this<policy_client> {
+public:
+  typedef connection_pool::callback callback;
+
+  policy_client(std::shared_ptr<connection_pool> pool, request_policy policy);
+
+  void query(request req, callback cb);
+
+  request_policy_stats const& stats() const { return stats_; }
+
+private:
+  struct query_state;
+
+  void attempt(std::shared_ptr<query_state> const& q, bool hedge);
+  void on_attempt(std::shared_ptr<query_state> const& q, std::size_t i,
+                  bool hedge, response res, boost::system::error_code ec);
+  void finish(std::shared_ptr<query_state> const& q, response res,
+              boost::system::error_code ec);
+
+  std::chrono::milliseconds backoff(unsigned retry);
+  void record_latency(std::string const& key, std::chrono::microseconds);
+  bool hedge_delay(std::string const& key, std::chrono::microseconds& delay);
+
+  std::shared_ptr<connection_pool> pool_;
+  request_policy policy_;
+  request_policy_stats stats_;
+
+  std::mutex mutex_;
+  std::minstd_rand rng_{std::random_device{}()};
+
+  // Recent latencies per host:port (ring buffers).
+  struct latencies {
+    std::vector<std::uint32_t> us_;
+    std::size_t next_{0U};
+  };
+  std::map<std::string, latencies> latencies_;
+};
+
+template <typename... Args>
+std::shared_ptr<policy_client> make_policy_client(Args&&... args) {
+  return std::make_shared<policy_client>(std::forward<Args>(args)...);
+}
+
+}  // namespace client
+}  // namespace http
+}  // namespace net
+
+#endif  // NET_HTTP_CLIENT_REQUEST_POLICY_H_
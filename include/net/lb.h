@@ -1,14 +1,69 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <type_traits>
+#include <utility>
 
+#include "net/cancel_token.h"
 #include "net/web_server/web_server.h"
 
 namespace net {
 
+enum class lb_state : std::uint8_t { kConnecting, kConnected, kDisconnected };
+
+struct lb_settings {
+  // Number of parallel tunnel connections to the balancer.
+  // Each connection reconnects independently.
+  unsigned connections_{1U};
+
+  // Interval between two load reports sent to the balancer.
+  std::chrono::milliseconds load_interval_{250};
+
+  // Maximum body bytes per frame: large responses are sent as a sequence
+  // of frames interleaved with other responses.
+  std::size_t max_chunk_size_{64U * 1024U};
+
+  // Optional: number of requests waiting for an executor thread
+  // (reported as queue depth).
+  std::function<std::size_t()> queue_depth_;
+
+  // Reconnect delay: doubles with every failed attempt from reconnect_min_
+  // up to reconnect_max_, randomized to [delay / 2, delay].
+  std::chrono::milliseconds reconnect_min_{100};
+  std::chrono::milliseconds reconnect_max_{30000};
+
+  // The delay starts over from reconnect_min_ only after a connection
+  // received a message or stayed up this long: a balancer that accepts
+  // and immediately drops connections keeps the backoff growing.
+  std::chrono::milliseconds reconnect_stable_{10000};
+
+  // Optional: called with the connection index on every state change.
+  std::function<void(unsigned, lb_state)> on_state_change_;
+};
+
 struct lb {
+  using http_req_cb_t = std::function<void(web_server::http_req_t,
+                                           web_server::http_res_cb_t,
+                                           bool,
+                                           cancel_token)>;
+
   lb(boost::asio::io_context&, std::string const& url,
-     web_server::http_req_cb_t);
+     web_server::http_req_cb_t, lb_settings const& = {});
+  lb(boost::asio::io_context&, std::string const& url, http_req_cb_t,
+     lb_settings const& = {});
+
+  // Handlers that accept both signatures (e.g. query_router) get the token.
+  template <typename Fn>
+    requires std::is_invocable_v<Fn&, web_server::http_req_t,
+                                 web_server::http_res_cb_t, bool,
+                                 cancel_token>
+  lb(boost::asio::io_context& ioc, std::string const& url, Fn&& fn,
+     lb_settings const& settings = {})
+      : lb{ioc, url, http_req_cb_t{std::forward<Fn>(fn)}, settings} {}
+
   lb(lb&&);
   lb& operator=(lb&&);
   ~lb();
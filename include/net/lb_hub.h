@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "boost/asio/io_context.hpp"
+
+#include "net/web_server/web_server.h"
+
+namespace net {
+
+struct lb_hub_settings {
+  // Target path of worker tunnel connections.
+  std::string path_{"/lb"};
+
+  // A request is sent to another worker if its tunnel fails before the
+  // response is complete, up to this many attempts in total. Requests with
+  // non-idempotent methods (POST, PATCH, ...) are only sent again if they
+  // never reached the worker, otherwise the client gets 502.
+  unsigned max_attempts_{3U};
+
+  // Deadline forwarded to the worker with every request (0 = none). The
+  // hub answers 504 (and cancels the stream) if it passes without a
+  // complete response, retries included.
+  std::chrono::milliseconds request_timeout_{std::chrono::seconds{30}};
+};
+
+// Counterpart of `lb`: accepts worker tunnels (binary tunnel protocol only)
+// and dispatches public HTTP requests to them. Each request goes to the
+// less loaded one of two randomly chosen workers.
+struct lb_hub {
+  explicit lb_hub(boost::asio::io_context&, lb_hub_settings = {});
+  ~lb_hub();
+
+  lb_hub(lb_hub const&) = delete;
+  lb_hub& operator=(lb_hub const&) = delete;
+
+  // Installs the HTTP request, WebSocket open and upgrade callbacks and the
+  // tunnel subprotocol on the server. Servers with additional handlers can
+  // call the functions below from their own callbacks instead.
+  void attach(web_server&) const;
+
+  void on_http_request(web_server::http_req_t, web_server::http_res_cb_t,
+                       bool is_ssl) const;
+
+  // Rejects tunnel upgrades without the tunnel subprotocol.
+  bool on_upgrade_ok(web_server::http_req_t const&) const;
+
+  // Returns false if the connection is not a worker tunnel.
+  bool on_ws_open(ws_session_ptr const&, std::string const& target) const;
+
+  std::size_t n_workers() const;
+
+  struct impl;
+  std::shared_ptr<impl> impl_;
+};
+
+}  // namespace net
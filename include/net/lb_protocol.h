@@ -0,0 +1,122 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "net/web_server/web_server.h"
+
+// Binary framing for the lb WebSocket tunnel.
+//
+// Every WebSocket message carries exactly one frame:
+//
+//   u8  type
+//   u8  flags
+//   u32 stream id
+//   ... payload
+//
+// REQUEST   u32 timeout in milliseconds (0 = none), u16 method length,
+//           method, u32 target length, target, header table,
+//           body (may be continued by DATA frames)
+// RESPONSE  u16 status, header table, body (may be continued by DATA frames)
+// DATA      body bytes
+// LOAD      u32 in-flight requests, u32 queue depth,
+//           u32 response latency EWMA (microseconds),
+//           u16 process CPU (permille of all cores),
+//           u16 load average (percent of all cores); stream id 0
+// CANCEL    no payload: the sender abandons the stream (balancer: nobody
+//           is waiting for the response anymore, backend: the response
+//           could not be completed)
+//
+// Header table: u16 count, then per entry u16 name length, name,
+// u32 value length, value. All integers are little endian.
+// END_STREAM marks the last frame of a request or response.
+//
+// The protocol is negotiated with the WebSocket subprotocol
+// `kLbProtocol`. Without it, the tunnel falls back to plain HTTP/1.1 text
+// messages correlated by the x-request-id header.
+namespace net {
+
+constexpr auto const kLbProtocol = std::string_view{"net-lb.v1"};
+
+enum class frame_type : std::uint8_t {
+  kRequest = 1,
+  kResponse = 2,
+  kData = 3,
+  kLoad = 4,
+  kCancel = 5
+};
+
+enum frame_flags : std::uint8_t { kNoFlags = 0U, kEndStream = 1U };
+
+struct frame {
+  frame_type type_;
+  std::uint8_t flags_;
+  std::uint32_t stream_id_;
+  std::string_view payload_;
+};
+
+struct load_report {
+  std::uint32_t in_flight_{0U};
+  std::uint32_t queue_depth_{0U};
+  std::uint32_t latency_us_{0U};
+  std::uint16_t cpu_permille_{0U};
+  std::uint16_t load_avg_pct_{0U};
+};
+
+constexpr auto const kFrameHeaderSize = std::size_t{6U};
+
+// Throws std::runtime_error on malformed input.
+frame decode_frame(std::string_view msg);
+
+struct request_frame {
+  std::chrono::milliseconds timeout_;
+  web_server::http_req_t req_;
+};
+
+std::string encode_request(
+    std::uint32_t stream_id,
+    web_server::http_req_t const&,
+    std::chrono::milliseconds timeout = std::chrono::milliseconds{0});
+
+// Decodes timeout, header table and body of a REQUEST frame payload.
+request_frame decode_request(std::string_view payload);
+
+// Splits a response into one RESPONSE frame followed by DATA frames with
+// at most `max_chunk` body bytes each. File bodies are read chunk by chunk,
+// so only one chunk is held in memory at a time.
+struct response_encoder {
+  response_encoder(std::uint32_t stream_id, web_server::http_res_t&&,
+                   std::size_t max_chunk);
+
+  std::uint32_t stream_id() const { return stream_id_; }
+  bool done() const { return done_; }
+
+  // Returns the next frame. Must not be called when done().
+  std::string next();
+
+private:
+  std::string_view read_chunk();
+
+  std::uint32_t stream_id_;
+  web_server::http_res_t res_;
+  std::size_t max_chunk_;
+  std::uint64_t size_{0U}, offset_{0U};
+  std::string buf_;
+  bool header_sent_{false}, done_{false};
+};
+
+// Decodes header table and body of a RESPONSE frame payload.
+web_server::string_res_t decode_response(std::string_view payload);
+
+std::string encode_data(std::uint32_t stream_id, std::uint8_t flags,
+                        std::string_view data);
+
+std::string encode_load(load_report const&);
+
+load_report decode_load(std::string_view payload);
+
+std::string encode_cancel(std::uint32_t stream_id);
+
+}  // namespace net
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+namespace net {
+
+// Unbounded lock-free multi-producer single-consumer queue.
+// push() may be called from any thread, pop() only from the consumer
+// (usually the strand owning the queue).
+// Based on Dmitry Vyukov's intrusive MPSC node-based queue.
+// Consumed nodes are kept on a free list and reused by push(), so a queue
+// in steady state does not allocate.
+template <typename T>
+struct mpsc_queue {
+  mpsc_queue() : head_{&stub_}, tail_{&stub_} {}
+
+  ~mpsc_queue() {
+    while (pop().has_value()) {
+    }
+    for (auto n = free_.load(); n != nullptr;) {
+      delete std::exchange(n, n->next_.load());
+    }
+  }
+
+  mpsc_queue(mpsc_queue const&) = delete;
+  mpsc_queue& operator=(mpsc_queue const&) = delete;
+  mpsc_queue(mpsc_queue&&) = delete;
+  mpsc_queue& operator=(mpsc_queue&&) = delete;
+
+  void push(T value) {
+    auto const n = acquire();
+    n->value_.emplace(std::move(value));
+    push(n);
+  }
+
+  std::optional<T> pop() {
+    auto tail = tail_;
+    auto next = tail->next_.load();
+
+    if (tail == &stub_) {
+      if (next == nullptr) {
+        return std::nullopt;
+      }
+      tail_ = next;
+      tail = next;
+      next = next->next_.load();
+    }
+
+    if (next != nullptr) {
+      tail_ = next;
+      return take(tail);
+    }
+
+    if (tail != head_.load()) {
+      // A producer is between exchanging head_ and linking its node.
+      return std::nullopt;
+    }
+
+    push(&stub_);
+
+    next = tail->next_.load();
+    if (next != nullptr) {
+      tail_ = next;
+      return take(tail);
+    }
+
+    return std::nullopt;
+  }
+
+private:
+  // Free nodes kept for reuse, beyond that consumed nodes are deleted.
+  static constexpr auto const kMaxFree = std::size_t{64U};
+
+  struct node {
+    std::atomic<node*> next_{nullptr};  // queue or free list link
+    std::optional<T> value_;
+  };
+
+  // Only one producer at a time takes from the free list (the consumer only
+  // adds to it), which rules out ABA. Producers finding it taken allocate
+  // instead of waiting.
+  node* acquire() {
+    if (!free_taken_.exchange(true)) {
+      auto n = free_.load();
+      while (n != nullptr &&
+             !free_.compare_exchange_weak(n, n->next_.load())) {
+      }
+      free_taken_ = false;
+      if (n != nullptr) {
+        --n_free_;
+        return n;
+      }
+    }
+    return new node{};
+  }
+
+  void release(node* n) {
+    n->value_.reset();
+    if (n_free_.load() >= kMaxFree) {
+      delete n;
+      return;
+    }
+    ++n_free_;
+    auto top = free_.load();
+    do {
+      n->next_.store(top);
+    } while (!free_.compare_exchange_weak(top, n));
+  }
+
+  void push(node* n) {
+    n->next_.store(nullptr);
+    auto const prev = head_.exchange(n);
+    prev->next_.store(n);
+  }
+
+  std::optional<T> take(node* n) {
+    auto value = std::move(n->value_);
+    release(n);
+    return value;
+  }
+
+  std::atomic<node*> head_;
+  node* tail_;
+  node stub_;
+
+  std::atomic<node*> free_{nullptr};
+  std::atomic_size_t n_free_{0U};
+  std::atomic_bool free_taken_{false};
+};
+
+}  // namespace net
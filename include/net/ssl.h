@@ -1,6 +1,7 @@
 #ifndef NET_SSL_H_
 #define NET_SSL_H_
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
@@ -9,6 +10,10 @@
 #include "boost/asio/ssl.hpp"
 #include "boost/date_time/posix_time/posix_time_types.hpp"
 
+#include "net/dns_cache.h"
+#include "net/happy_eyeballs.h"
+#include "net/ssl_client_context.h"
+
 namespace net {
 
 class ssl : public std::enable_shared_from_this<ssl> {
@@ -17,7 +22,8 @@ public:
   typedef std::function<void(ssl_ptr, boost::system::error_code)> connect_cb;
 
   ssl(boost::asio::io_context& io_context, std::string host, std::string port,
-      boost::posix_time::time_duration const& timeout);
+      boost::posix_time::time_duration const& timeout,
+      std::shared_ptr<ssl_client_context> ctx = ssl_client_context::shared());
 
   ~ssl();
 
@@ -30,11 +36,10 @@ public:
   void resolve(ssl_ptr self, connect_cb cb);
 
   void on_resolve(ssl_ptr self, connect_cb cb, boost::system::error_code ec,
-                  boost::asio::ip::tcp::resolver::iterator iterator);
+                  dns_cache::endpoints endpoints);
 
   void on_connect(ssl_ptr const& self, const connect_cb& cb,
-                  boost::system::error_code ec,
-                  boost::asio::ip::tcp::resolver::iterator const&);
+                  boost::system::error_code ec);
 
   void on_handshake(ssl_ptr self, const connect_cb& cb,
                     boost::system::error_code ec);
@@ -43,12 +48,16 @@ public:
 
   void finally(boost::system::error_code const& ec);
 
-  boost::asio::ssl::context ctx_;
-  boost::asio::ip::tcp::resolver resolver_;
+  std::shared_ptr<ssl_client_context> ctx_;
+  std::string session_key_;
+  std::shared_ptr<dns_cache> dns_;
+  std::shared_ptr<happy_eyeballs> connecting_;
   boost::asio::ssl::stream<boost::asio::ip::tcp::socket> socket_;
   boost::asio::deadline_timer req_timeout_timer_;
+  std::uint64_t timeout_generation_{0U};  // ignores stale timer handlers
+  boost::posix_time::time_duration timeout_;
   std::string host_, port_;
-  bool connected_;
+  bool connected_, aborted_;
 };
 
 }  // namespace net
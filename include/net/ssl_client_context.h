@@ -0,0 +1,60 @@
+#ifndef NET_SSL_CLIENT_CONTEXT_H_
+#define NET_SSL_CLIENT_CONTEXT_H_
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "boost/asio/ssl.hpp"
+
+namespace net {
+
+// TLS client context shared by connections (building one per connection is
+// expensive). Remembers the last session per host:port so that subsequent
+// connections to the same server resume the session instead of doing a
+// full handshake. Beyond `max_sessions`, the least recently used host's
+// session is dropped.
+class ssl_client_context {
+public:
+  explicit ssl_client_context(std::size_t max_sessions = 256U);
+  ~ssl_client_context();
+
+  ssl_client_context(ssl_client_context const&) = delete;
+  ssl_client_context& operator=(ssl_client_context const&) = delete;
+
+  // Process-wide default context (used by net::ssl).
+  static std::shared_ptr<ssl_client_context> const& shared();
+
+  boost::asio::ssl::context& get() { return ctx_; }
+
+  // Offers the cached session for `key` (if any) on the connection and
+  // stores new sessions the server issues on it under `key`.
+  // `key` has to outlive the connection.
+  void prepare(SSL* ssl, std::string const* key);
+
+  // Drops the cached session for `key` (e.g. after a failed handshake).
+  void forget(std::string const& key);
+
+private:
+  struct cached_session {
+    std::string key_;
+    SSL_SESSION* session_;
+  };
+  using session_it = std::list<cached_session>::iterator;
+
+  static int on_new_session(SSL*, SSL_SESSION*);
+  void store(std::string const& key, SSL_SESSION*);
+
+  boost::asio::ssl::context ctx_;
+  std::size_t max_sessions_;
+  std::mutex mutex_;
+  std::list<cached_session> sessions_;  // most recently used first
+  std::map<std::string, session_it> index_;  // by key
+};
+
+}  // namespace net
+
+#endif  // NET_SSL_CLIENT_CONTEXT_H_
@@ -1,6 +1,7 @@
 #ifndef NET_TCP_H_
 #define NET_TCP_H_
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
@@ -8,6 +9,9 @@
 #include "boost/asio.hpp"
 #include "boost/date_time/posix_time/posix_time_types.hpp"
 
+#include "net/dns_cache.h"
+#include "net/happy_eyeballs.h"
+
 namespace net {
 
 class tcp : public std::enable_shared_from_this<tcp> {
@@ -31,21 +35,23 @@ public:
   void resolve(tcp_ptr self, connect_cb cb);
 
   void on_resolve(tcp_ptr self, connect_cb cb, boost::system::error_code ec,
-                  boost::asio::ip::tcp::resolver::iterator iterator);
+                  dns_cache::endpoints endpoints);
 
   void on_connect(tcp_ptr self, const connect_cb& cb,
-                  boost::system::error_code ec,
-                  boost::asio::ip::tcp::resolver::iterator const&);
+                  boost::system::error_code ec);
 
   void timer_callback(const tcp_ptr& self, boost::system::error_code const& ec);
 
   void finally(boost::system::error_code const& ec);
 
-  boost::asio::ip::tcp::resolver resolver_;
+  std::shared_ptr<dns_cache> dns_;
+  std::shared_ptr<happy_eyeballs> connecting_;
   boost::asio::ip::tcp::socket socket_;
   boost::asio::deadline_timer req_timeout_timer_;
+  std::uint64_t timeout_generation_{0U};  // ignores stale timer handlers
+  boost::posix_time::time_duration timeout_;
   std::string host_, port_;
-  bool use_timeout_, connected_;
+  bool use_timeout_, connected_, aborted_;
 };
 
 }  // namespace net
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+#include "boost/beast/core/flat_buffer.hpp"
+
+namespace net {
+
+// Hands the memory of a drained buffer back to the allocator once it grew
+// beyond `limit`. Beast allocates lazily on the next prepare(), so an idle
+// connection only pays for its buffer again when data arrives.
+inline void compact_buffer(boost::beast::flat_buffer& buf,
+                           std::size_t const limit) {
+  if (buf.size() == 0U && buf.capacity() > limit) {
+    buf.shrink_to_fit();
+  }
+}
+
+}  // namespace net
@@ -5,6 +5,7 @@
 #if defined(NET_TLS)
 #include "boost/asio/ssl/error.hpp"
 #endif
+#include "boost/asio/error.hpp"
 #include "boost/beast/core/error.hpp"
 
 namespace net {
@@ -27,12 +28,16 @@ inline void fail(boost::beast::error_code ec, char const* what) {
   // Beast returns the error boost::beast::http::error::partial_message.
   // Therefore, if we see a short read here, it has occurred
   // after the message has been completed, so it is safe to ignore it.
+  //
+  // operation_aborted is reported for reads and writes of sessions that
+  // were closed by the timer wheel.
 
   if (
 #if defined(NET_TLS)
       ec == boost::asio::ssl::error::stream_truncated ||
 #endif
-      ec == boost::beast::error::timeout) {
+      ec == boost::beast::error::timeout ||
+      ec == boost::asio::error::operation_aborted) {
     return;
   }
 
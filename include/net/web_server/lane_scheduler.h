@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include "net/web_server/work_stealing_pool.h"
+
+namespace net {
+
+enum class route_priority : std::uint8_t { kHigh, kNormal, kLow };
+
+struct route_options {
+  route_priority priority_{route_priority::kNormal};
+
+  // Handlers of this route running at the same time (0 = no limit).
+  // Further requests wait without blocking other routes.
+  std::size_t max_concurrency_{0U};
+};
+
+struct lane_settings {
+  // Tasks taken from each lane (high, normal, low) per scheduling round
+  // while all of them have work: low priority is slowed down, not starved.
+  std::array<unsigned, 3U> weights_{8U, 4U, 1U};
+
+  // Tasks handed to the pool at the same time (0 = pool size). Everything
+  // beyond waits in the lanes, so the weights decide what runs next.
+  std::size_t max_running_{0U};
+
+  // Waiting tasks per lane (0 = no limit). A full lane rejects (429).
+  std::size_t max_queued_{0U};
+};
+
+// Schedules route handlers onto a work_stealing_pool: one queue per
+// priority lane, weighted round-robin between the lanes and a concurrency
+// limit per route.
+struct lane_scheduler {
+  using task_t = std::function<void()>;
+
+  struct route_state {
+    explicit route_state(route_options options)
+        : options_{std::move(options)} {}
+
+    route_options options_;
+    std::size_t admitted_{0U};  // running or waiting in its lane
+    std::deque<task_t> blocked_;  // over max_concurrency_
+  };
+
+  explicit lane_scheduler(work_stealing_pool&,
+                          lane_settings settings = lane_settings{});
+
+  std::shared_ptr<route_state> add_route(route_options);
+
+  // Returns false (and drops the task) if the route's lane is full.
+  bool submit(std::shared_ptr<route_state> const&, task_t);
+
+private:
+  struct entry {
+    std::shared_ptr<route_state> route_;
+    task_t task_;
+  };
+
+  static std::size_t lane(route_state const& r) {
+    return static_cast<std::size_t>(r.options_.priority_);
+  }
+
+  std::optional<entry> next();
+  void run(entry);
+  void schedule(std::unique_lock<std::mutex>&);
+
+  work_stealing_pool& pool_;
+  lane_settings settings_;
+
+  std::mutex mutex_;
+  std::array<std::deque<entry>, 3U> lanes_;
+  std::array<std::size_t, 3U> queued_{};  // incl. blocked per route
+  std::array<unsigned, 3U> credits_{};
+  std::size_t running_{0U};
+};
+
+}  // namespace net
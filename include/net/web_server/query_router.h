@@ -21,14 +21,17 @@
 
 #include "net/bad_request_exception.h"
 #include "net/base64.h"
+#include "net/cancel_token.h"
 #include "net/not_found_exception.h"
 #include "net/too_many_exception.h"
 #include "net/web_server/content_encoding.h"
 #include "net/web_server/enable_cors.h"
+#include "net/web_server/lane_scheduler.h"
 #include "net/web_server/responses.h"
 #include "net/web_server/serve_static.h"
 #include "net/web_server/url_decode.h"
 #include "net/web_server/web_server.h"
+#include "net/web_server/work_stealing_pool.h"
 
 namespace net {
 
@@ -94,6 +97,15 @@ concept JsonUrlPostHandler = requires(boost::urls::url_view const& url,
   { f(url, body) } -> JSON;
 };
 
+// Executors skip requests whose cancel_token has expired by the time a
+// worker picks them up and answer with this instead.
+inline web_server::http_res_t cancelled_response() {
+  auto str = web_server::string_res_t{
+      boost::beast::http::status::service_unavailable, 11};
+  str.prepare_payload();
+  return str;
+}
+
 struct default_exec {
   void exec(auto&& fn, web_server::http_res_cb_t cb) { cb(fn()); }
 };
@@ -101,11 +113,14 @@ struct default_exec {
 struct asio_exec {
   asio_exec(boost::asio::io_context& io, boost::asio::io_context& worker_pool);
 
-  void exec(auto&& f, web_server::http_res_cb_t cb) {
+  void exec(auto&& f, web_server::http_res_cb_t cb,
+            cancel_token token = {}) {
     boost::asio::post(
-        worker_pool_, [&, f = std::move(f), cb = std::move(cb)]() mutable {
+        worker_pool_, [&, f = std::move(f), cb = std::move(cb),
+                       token = std::move(token)]() mutable {
           try {
-            auto res = std::make_shared<web_server::http_res_t>(f());
+            auto res = std::make_shared<web_server::http_res_t>(
+                token.cancelled() ? cancelled_response() : f());
             boost::asio::post(
                 io_, [cb = std::move(cb), res = std::move(res)]() mutable {
                   cb(std::move(*res));
@@ -131,16 +146,86 @@ struct asio_exec {
   boost::asio::io_context& worker_pool_;
 };
 
+// Runs handlers on a work_stealing_pool. The response callback is called
+// from the worker thread: http_session hands the response over to the
+// connection's own strand, there is no detour through a global io_context.
+struct work_stealing_exec {
+  explicit work_stealing_exec(work_stealing_pool& pool) : pool_{pool} {}
+
+  void exec(auto&& f, web_server::http_res_cb_t cb,
+            cancel_token token = {}) {
+    pool_.post([f = std::move(f), cb = std::move(cb),
+                token = std::move(token)]() mutable {
+      try {
+        cb(token.cancelled() ? cancelled_response() : f());
+      } catch (...) {
+        std::cerr << "UNEXPECTED EXCEPTION\n";
+
+        auto str = web_server::string_res_t{
+            boost::beast::http::status::internal_server_error, 11};
+        str.body() = "error";
+        str.prepare_payload();
+        cb(web_server::http_res_t{std::move(str)});
+      }
+    });
+  }
+
+  work_stealing_pool& pool_;
+};
+
+// Runs handlers through a lane_scheduler: route options (priority lane,
+// max. concurrency) apply. A full lane is answered with 429.
+struct priority_exec {
+  explicit priority_exec(lane_scheduler& scheduler) : scheduler_{scheduler} {}
+
+  std::shared_ptr<lane_scheduler::route_state> add_route(
+      route_options const& options) {
+    return scheduler_.add_route(options);
+  }
+
+  void exec(auto&& f, web_server::http_res_cb_t cb,
+            std::shared_ptr<lane_scheduler::route_state> const& route,
+            cancel_token token = {}) {
+    auto const shared_cb =
+        std::make_shared<web_server::http_res_cb_t>(std::move(cb));
+    auto const accepted = scheduler_.submit(
+        route,
+        [f = std::move(f), shared_cb, token = std::move(token)]() mutable {
+          try {
+            (*shared_cb)(token.cancelled() ? cancelled_response() : f());
+          } catch (...) {
+            std::cerr << "UNEXPECTED EXCEPTION\n";
+
+            auto str = web_server::string_res_t{
+                boost::beast::http::status::internal_server_error, 11};
+            str.body() = "error";
+            str.prepare_payload();
+            (*shared_cb)(web_server::http_res_t{std::move(str)});
+          }
+        });
+    if (!accepted) {
+      auto str = web_server::string_res_t{
+          boost::beast::http::status::too_many_requests, 11};
+      str.prepare_payload();
+      (*shared_cb)(web_server::http_res_t{std::move(str)});
+    }
+  }
+
+  lane_scheduler& scheduler_;
+};
+
 struct fiber_exec {
   using task_t = std::function<void()>;
   using channel_t = boost::fibers::buffered_channel<task_t>;
 
   fiber_exec(boost::asio::io_context& io, channel_t& ch) : io_{io}, ch_{ch} {}
 
-  void exec(auto&& f, net::web_server::http_res_cb_t cb) {
-    auto const result =
-        ch_.try_push([&, f = std::move(f), cb = std::move(cb)]() {
-          auto res = std::make_shared<net::web_server::http_res_t>(f());
+  void exec(auto&& f, net::web_server::http_res_cb_t cb,
+            cancel_token token = {}) {
+    auto const result = ch_.try_push(
+        [&, f = std::move(f), cb = std::move(cb), token = std::move(token)]() {
+          auto res = std::make_shared<net::web_server::http_res_t>(
+              token.cancelled() ? cancelled_response() : f());
           boost::asio::post(
               io_, [cb = std::move(cb), res = std::move(res)]() mutable {
                 cb(std::move(*res));
@@ -186,15 +271,33 @@ struct handler {
   std::string method_;
   std::string prefix_;
   route_request_handler request_handler_;
+  route_options options_;
+  std::shared_ptr<lane_scheduler::route_state> lane_;
 };
 
+// Executors that schedule per route (see priority_exec). Others ignore
+// the route options.
+template <typename Executor>
+concept RouteAwareExecutor =
+    requires(Executor& e, route_options const& options) {
+      {
+        e.add_route(options)
+      } -> std::same_as<std::shared_ptr<lane_scheduler::route_state>>;
+    };
+
 template <typename Executor = default_exec>
 struct query_router {
   explicit query_router(Executor&& exec) : exec_{std::move(exec)} {}
 
   query_router& route(std::string method, std::string prefix,
-                      route_request_handler h) {
-    routes_.push_back({std::move(method), std::move(prefix), std::move(h)});
+                      route_request_handler h,
+                      route_options options = route_options{}) {
+    auto lane = std::shared_ptr<lane_scheduler::route_state>{};
+    if constexpr (RouteAwareExecutor<Executor>) {
+      lane = exec_.add_route(options);
+    }
+    routes_.push_back({std::move(method), std::move(prefix), std::move(h),
+                       std::move(options), std::move(lane)});
     return *this;
   }
 
@@ -203,7 +306,7 @@ struct query_router {
       { f(req) } -> std::same_as<std::string>;
     }
   query_router& route(std::string method, std::string const& path_regex,
-                      Fn&& fn) {
+                      Fn&& fn, route_options options = route_options{}) {
     return route(std::move(method), path_regex,
                  [fn = std::forward<Fn>(fn)](web_server::http_req_t const& req,
                                              bool is_ssl) -> reply {
@@ -212,27 +315,34 @@ struct query_router {
                    set_response_body(res, req, fn(req.body()));
                    res.keep_alive(req.keep_alive());
                    return res;
-                 });
+                 },
+                 options);
   }
 
   template <ContentOnlyHandler Fn>
-  query_router& get(std::string const& path_regex, Fn&& fn) {
+  query_router& get(std::string const& path_regex, Fn&& fn,
+                    route_options options = route_options{}) {
     return get(path_regex,
                [fn = std::forward<Fn>(fn)](boost::urls::url_view const& url) {
                  return std::make_pair(boost::beast::http::status::ok, fn(url));
-               });
+               },
+               options);
   }
 
   template <ContentOnlyHandler Fn>
-  query_router& post(std::string const& path_regex, Fn&& fn) {
-    return post(path_regex, [fn = std::forward<Fn>(fn)](
-                                typename utl::first_argument<Fn> arg) {
-      return std::make_pair(boost::beast::http::status::ok, fn(arg));
-    });
+  query_router& post(std::string const& path_regex, Fn&& fn,
+                     route_options options = route_options{}) {
+    return post(
+        path_regex,
+        [fn = std::forward<Fn>(fn)](typename utl::first_argument<Fn> arg) {
+          return std::make_pair(boost::beast::http::status::ok, fn(arg));
+        },
+        options);
   }
 
   template <StringPostHandler Fn>
-  query_router& post(std::string const& path_regex, Fn&& fn) {
+  query_router& post(std::string const& path_regex, Fn&& fn,
+                     route_options options = route_options{}) {
     return route("POST", path_regex,
                  [fn = std::forward<Fn>(fn)](web_server::http_req_t const& req,
                                              bool is_ssl) {
@@ -242,11 +352,13 @@ struct query_router {
                    set_response_body(res, req, content);
                    res.keep_alive(req.keep_alive());
                    return res;
-                 });
+                 },
+                 options);
   }
 
   template <StringGetHandler Fn>
-  query_router& get(std::string const& path_regex, Fn&& fn) {
+  query_router& get(std::string const& path_regex, Fn&& fn,
+                    route_options options = route_options{}) {
     return route("GET", path_regex,
                  [fn = std::forward<Fn>(fn)](route_request const& req, bool) {
                    auto [status, content] = fn(boost::url_view{req.target()});
@@ -255,11 +367,13 @@ struct query_router {
                    set_response_body(res, req, content);
                    res.keep_alive(req.keep_alive());
                    return res;
-                 });
+                 },
+                 options);
   }
 
   template <JsonPostHandler Fn>
-  query_router& post(std::string const& path_regex, Fn&& fn) {
+  query_router& post(std::string const& path_regex, Fn&& fn,
+                     route_options options = route_options{}) {
     return route(
         "POST", path_regex,
         [fn = std::forward<Fn>(fn)](web_server::http_req_t const& req,
@@ -274,11 +388,13 @@ struct query_router {
               boost::json::serialize(boost::json::value_from(content)));
           res.keep_alive(req.keep_alive());
           return res;
-        });
+        },
+        options);
   }
 
   template <JsonUrlPostHandler Fn>
-  query_router& post(std::string const& path_regex, Fn&& fn) {
+  query_router& post(std::string const& path_regex, Fn&& fn,
+                     route_options options = route_options{}) {
     namespace json = boost::json;
     return route(
         "POST", path_regex,
@@ -294,11 +410,13 @@ struct query_router {
                             json::serialize(json::value_from(content)));
           res.keep_alive(req.keep_alive());
           return res;
-        });
+        },
+        options);
   }
 
   template <JsonGetHandler Fn>
-  query_router& get(std::string const& path_regex, Fn&& fn) {
+  query_router& get(std::string const& path_regex, Fn&& fn,
+                    route_options options = route_options{}) {
     namespace json = boost::json;
     return route("GET", path_regex,
                  [fn = std::forward<Fn>(fn)](route_request const& req, bool) {
@@ -311,11 +429,14 @@ struct query_router {
                        res, req, json::serialize(json::value_from(content)));
                    res.keep_alive(req.keep_alive());
                    return res;
-                 });
+                 },
+                 options);
   }
 
+  // The token (e.g. from lb::http_req_cb_t) is forwarded to executors that
+  // accept one: they skip the handler once it has expired.
   void operator()(web_server::http_req_t req, web_server::http_res_cb_t cb,
-                  bool is_ssl) {
+                  bool is_ssl, cancel_token token = {}) {
     try {
       auto const url = boost::urls::url_view{req.target()};
       auto const path = url.path();
@@ -338,7 +459,7 @@ struct query_router {
       set_credentials(route_req);
       decode_content(route_req);
 
-      return exec_.exec(
+      return exec(
           [this, route, is_ssl, r = std::move(route_req)]() {
             reply rep;
             using namespace boost::json;
@@ -381,7 +502,7 @@ struct query_router {
                 rep);
             return std::move(rep);
           },
-          std::move(cb));
+          std::move(cb), *route, std::move(token));
     } catch (...) {
       auto rep = reply{bad_request_response(
           req, serialize(
@@ -421,6 +542,23 @@ struct query_router {
   }
 
 private:
+  void exec(auto&& fn, web_server::http_res_cb_t cb, handler const& h,
+            cancel_token token) {
+    if constexpr (RouteAwareExecutor<Executor>) {
+      if constexpr (requires { exec_.exec(fn, cb, h.lane_, token); }) {
+        exec_.exec(std::forward<decltype(fn)>(fn), std::move(cb), h.lane_,
+                   std::move(token));
+      } else {
+        exec_.exec(std::forward<decltype(fn)>(fn), std::move(cb), h.lane_);
+      }
+    } else if constexpr (requires { exec_.exec(fn, cb, token); }) {
+      exec_.exec(std::forward<decltype(fn)>(fn), std::move(cb),
+                 std::move(token));
+    } else {
+      exec_.exec(std::forward<decltype(fn)>(fn), std::move(cb));
+    }
+  }
+
   void decode_content(request& req) {
     if (auto const it =
             req.base().find(boost::beast::http::field::content_type);
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "boost/intrusive/list.hpp"
+
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/steady_timer.hpp"
+#include "boost/asio/strand.hpp"
+
+namespace net {
+
+// Implemented by sessions that use the timer wheel for their timeouts.
+// on_timeout() is called from the wheel's strand and has to hop onto the
+// session's own executor before touching session state.
+struct timeout_target {
+  timeout_target() = default;
+  virtual ~timeout_target() = default;
+  timeout_target(timeout_target const&) = delete;
+  timeout_target& operator=(timeout_target const&) = delete;
+  timeout_target(timeout_target&&) = delete;
+  timeout_target& operator=(timeout_target&&) = delete;
+
+  virtual void on_timeout(std::uint64_t generation) = 0;
+};
+
+// Coarse-grained hierarchical timer wheel for connection timeouts.
+//
+// Each timeout is a `timer` owned by the session. Arming links it into a
+// slot in O(1); re-arming moves it and cancel() unlinks it, so the wheel
+// holds at most one entry per timer. A timer stays with the shard of the
+// thread that armed it first, so I/O threads don't contend with each
+// other. Sessions still bump a generation counter on re-arm: a timeout
+// that fires concurrently with a re-arm is ignored by the session.
+//
+// Level 0 has one slot per tick, level 1 one slot per level 0 revolution.
+// Entries further out wait in an overflow list that is redistributed once
+// per level 1 revolution.
+struct timer_wheel {
+private:
+  struct shard;
+
+public:
+  using clock = std::chrono::steady_clock;
+
+  // Must be destroyed before the wheel.
+  struct timer {
+    timer() = default;
+    ~timer();
+    timer(timer const&) = delete;
+    timer& operator=(timer const&) = delete;
+    timer(timer&&) = delete;
+    timer& operator=(timer&&) = delete;
+
+    void cancel();
+
+  private:
+    friend timer_wheel;
+
+    boost::intrusive::list_member_hook<
+        boost::intrusive::link_mode<boost::intrusive::auto_unlink>>
+        hook_;
+    shard* shard_{nullptr};
+    std::weak_ptr<timeout_target> target_;
+    std::uint64_t generation_{0U};
+    std::uint64_t expiry_{0U};  // in ticks since start
+  };
+
+  explicit timer_wheel(
+      boost::asio::io_context&,
+      std::chrono::milliseconds tick = std::chrono::milliseconds{100},
+      std::size_t n_shards = 0U);
+
+  void start();
+  void stop();
+
+  void arm(timer&, std::weak_ptr<timeout_target>, std::uint64_t generation,
+           std::chrono::nanoseconds timeout);
+
+private:
+  static constexpr auto const kL0Bits = 8U;
+  static constexpr auto const kL1Bits = 6U;
+  static constexpr auto const kL0Slots = std::uint64_t{1U} << kL0Bits;
+  static constexpr auto const kL1Slots = std::uint64_t{1U} << kL1Bits;
+
+  using slot_t = boost::intrusive::list<
+      timer,
+      boost::intrusive::member_hook<
+          timer,
+          boost::intrusive::list_member_hook<
+              boost::intrusive::link_mode<boost::intrusive::auto_unlink>>,
+          &timer::hook_>,
+      boost::intrusive::constant_time_size<false>>;
+
+  struct expired_timer {
+    std::weak_ptr<timeout_target> target_;
+    std::uint64_t generation_;
+  };
+
+  struct shard {
+    void insert(timer&);
+    void reinsert(slot_t&);
+    void advance(std::uint64_t until, std::vector<expired_timer>& expired);
+
+    std::mutex mutex_;
+    std::uint64_t current_{0U};  // next tick to process
+    std::array<slot_t, kL0Slots> l0_;
+    std::array<slot_t, kL1Slots> l1_;
+    slot_t overflow_;
+  };
+
+  void schedule_tick();
+  void on_tick();
+  std::uint64_t now_ticks() const;
+  shard& local_shard();
+
+  boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+  boost::asio::steady_timer timer_;
+  std::chrono::milliseconds tick_;
+  clock::time_point start_;
+  std::vector<std::unique_ptr<shard>> shards_;
+  std::atomic_bool running_{false};
+};
+
+}  // namespace net
@@ -6,6 +6,7 @@
 #include <memory>
 #include <string>
 #include <variant>
+#include <vector>
 
 #include "boost/asio/io_context.hpp"
 
@@ -25,6 +26,8 @@ enum class ws_msg_type { TEXT, BINARY };
 
 struct ws_session {
   using send_cb_t = std::function<void(boost::system::error_code, std::size_t)>;
+  // Thread-safe: may be called from any thread (e.g. worker pools).
+  // The callback is invoked on the session's strand.
   virtual void send(std::string msg, ws_msg_type type, send_cb_t cb) = 0;
   virtual void on_msg(
       std::function<void(std::string const&, ws_msg_type)>&&) = 0;
@@ -75,9 +78,21 @@ struct web_server {
   void run() const;
   void stop() const;
 
+  // Sets all timeouts below at once.
   void set_timeout(std::chrono::nanoseconds const& timeout) const;
+  void set_idle_timeout(std::chrono::nanoseconds const& timeout) const;
+  void set_header_timeout(std::chrono::nanoseconds const& timeout) const;
+  void set_body_timeout(std::chrono::nanoseconds const& timeout,
+                        std::uint64_t min_bytes_per_second = 0U) const;
+  void set_write_timeout(std::chrono::nanoseconds const& timeout) const;
+  void set_max_requests_per_connection(std::size_t limit) const;
   void set_request_body_limit(std::uint64_t limit) const;
   void set_request_queue_limit(std::size_t limit) const;
+  void set_idle_buffer_limit(std::size_t limit) const;
+
+  // The first subprotocol offered by a WebSocket client that is contained
+  // in this list is accepted (echoed in the handshake response).
+  void set_ws_subprotocols(std::vector<std::string> protocols) const;
 
   void on_http_request(http_req_cb_t) const;
   void on_ws_msg(ws_msg_cb_t) const;
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "net/web_server/timer_wheel.h"
 #include "net/web_server/web_server.h"
 
 namespace net {
@@ -11,9 +16,37 @@ struct web_server_settings {
   web_server::ws_close_cb_t ws_close_cb_;
   web_server::ws_upgrade_ok_cb_t ws_upgrade_ok_;
 
+  // SSL detection, TLS handshake and shutdown.
   std::chrono::nanoseconds timeout_{std::chrono::seconds(60)};
+
+  // Keep-alive: waiting for the first byte of the next request.
+  std::chrono::nanoseconds idle_timeout_{std::chrono::seconds(15)};
+
+  // From the first byte of a request until its header is complete.
+  std::chrono::nanoseconds header_timeout_{std::chrono::seconds(30)};
+
+  // Maximum time without progress while reading a request body.
+  std::chrono::nanoseconds body_timeout_{std::chrono::seconds(30)};
+
+  // Minimum average body transfer rate in bytes/s (0 = disabled).
+  std::uint64_t body_min_rate_{0U};
+
+  // Writing a single response.
+  std::chrono::nanoseconds write_timeout_{std::chrono::seconds(60)};
+
+  // Connections are closed after this many requests (0 = unlimited).
+  std::size_t max_requests_per_connection_{0U};
+
   std::uint64_t request_body_limit_{1024 * 1024};
   std::size_t request_queue_limit_{8};
+
+  // Read buffers of idle connections are released down to this size.
+  std::size_t idle_buffer_limit_{4096};
+
+  // WebSocket subprotocols accepted by the server.
+  std::vector<std::string> ws_subprotocols_;
+
+  std::shared_ptr<timer_wheel> timer_wheel_;
 };
 
 using web_server_settings_ptr = std::shared_ptr<web_server_settings>;
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include "boost/beast/core/tcp_stream.hpp"
 #include "boost/beast/http/message.hpp"
 #include "boost/beast/http/string_body.hpp"
@@ -13,6 +16,12 @@
 
 namespace net {
 
+// Returns the first protocol of the client's Sec-WebSocket-Protocol list
+// that is in `supported` (whole tokens), or an empty string.
+std::string select_subprotocol(
+    boost::beast::http::request<boost::beast::http::string_body> const& req,
+    std::vector<std::string> const& supported);
+
 void make_websocket_session(
     boost::beast::tcp_stream stream,
     boost::beast::http::request<boost::beast::http::string_body> req,
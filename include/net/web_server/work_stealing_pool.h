@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace net {
+
+// Thread pool with one task deque per worker instead of a single shared
+// queue.
+//
+// Tasks posted from a worker thread go to the back of its own deque and
+// are taken LIFO by the owner (the data they touch is likely still in the
+// cache). Tasks posted from other threads (e.g. requests from the I/O
+// threads) go to a shared FIFO injection queue, so the oldest request is
+// served first. A worker without own tasks takes from the injection queue,
+// then steals the oldest task from the front of another worker's deque
+// before going to sleep.
+//
+// The deques are guarded by one mutex each: the owner and at most a few
+// thieves ever compete for it.
+struct work_stealing_pool {
+  using task_t = std::function<void()>;
+
+  explicit work_stealing_pool(std::size_t n_threads = 0U);
+  ~work_stealing_pool();
+
+  work_stealing_pool(work_stealing_pool const&) = delete;
+  work_stealing_pool& operator=(work_stealing_pool const&) = delete;
+  work_stealing_pool(work_stealing_pool&&) = delete;
+  work_stealing_pool& operator=(work_stealing_pool&&) = delete;
+
+  void post(task_t);
+
+  // Runs the tasks already posted, then joins the workers.
+  // Throws std::logic_error on a worker thread (it can't join itself), so
+  // the pool must not be destroyed by one of its own tasks.
+  void stop();
+
+  std::size_t size() const { return workers_.size(); }
+
+private:
+  struct worker {
+    std::mutex mutex_;
+    std::deque<task_t> tasks_;
+    std::thread thread_;
+  };
+
+  void run(std::size_t id);
+  std::optional<task_t> pop(std::size_t id);
+  std::optional<task_t> pop_injected();
+  std::optional<task_t> steal(std::size_t id);
+
+  std::vector<std::unique_ptr<worker>> workers_;
+
+  std::mutex inject_mutex_;
+  std::deque<task_t> injected_;
+
+  // Number of queued tasks (all queues). Idle workers sleep until > 0.
+  std::atomic_size_t pending_{0U};
+  std::atomic_size_t sleeping_{0U};
+  std::mutex sleep_mutex_;
+  std::condition_variable wakeup_;
+  std::atomic_bool stop_{false};
+};
+
+}  // namespace net
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "utl/argument_helper.h"
+#include "utl/helpers/algorithm.h"
+
+#include "boost/json.hpp"
+
+#include "openapi/bad_request_exception.h"
+
+#include "net/bad_request_exception.h"
+#include "net/not_found_exception.h"
+#include "net/too_many_exception.h"
+#include "net/web_server/query_router.h"
+#include "net/web_server/web_server.h"
+
+namespace net {
+
+// Message-level router for WebSocket sessions.
+//
+// Request:  {"id": <any>, "type": "<route>", "payload": <json>}
+//           ("path" is accepted instead of "type")
+// Reply:    {"id": <id>, "type": "<route>", "status": 200, "payload": <json>}
+// Error:    {"id": <id>, "type": "<route>", "status": 4xx/5xx, "error": "..."}
+//
+// Handlers run on the same executors as `query_router` (`default_exec`,
+// `asio_exec`, `priority_exec`, ...), so load shedding (e.g. 429 from a full
+// fiber channel or lane) and route options apply to WebSocket requests as
+// well.
+template <typename Fn>
+concept WsJsonHandler = requires(Fn f, utl::first_argument<Fn> arg) {
+  { f(arg) } -> JSON;
+};
+
+template <typename Executor = default_exec>
+struct ws_router {
+  using ws_handler_t =
+      std::function<boost::json::value(boost::json::value const&)>;
+
+  struct ws_route {
+    std::string type_;
+    std::shared_ptr<ws_handler_t const> handler_;
+    std::shared_ptr<lane_scheduler::route_state> lane_;
+  };
+
+  explicit ws_router(Executor&& exec) : exec_{std::move(exec)} {}
+
+  template <WsJsonHandler Fn>
+  ws_router& route(std::string type, Fn&& fn,
+                   route_options const& options = route_options{}) {
+    using arg_t = std::decay_t<utl::first_argument<Fn>>;
+    auto lane = std::shared_ptr<lane_scheduler::route_state>{};
+    if constexpr (RouteAwareExecutor<Executor>) {
+      lane = exec_.add_route(options);
+    }
+    routes_.push_back(
+        {std::move(type),
+         std::make_shared<ws_handler_t const>(
+             [fn = std::forward<Fn>(fn)](boost::json::value const& payload) {
+               return boost::json::value_from(fn(to_arg<arg_t>(payload)));
+             }),
+         std::move(lane)});
+    return *this;
+  }
+
+  void operator()(ws_session_ptr const& session, std::string const& msg,
+                  ws_msg_type) {
+    namespace json = boost::json;
+
+    auto id = json::value{};
+    auto type = std::string{};
+    auto payload = json::value{};
+    try {
+      auto req = json::parse(msg);
+      auto& obj = req.as_object();
+      if (auto const it = obj.find("id"); it != obj.end()) {
+        id = it->value();
+      }
+      if (auto const it = obj.find("type"); it != obj.end()) {
+        type = json::value_to<std::string>(it->value());
+      } else if (auto const p = obj.find("path"); p != obj.end()) {
+        type = json::value_to<std::string>(p->value());
+      }
+      if (auto const it = obj.find("payload"); it != obj.end()) {
+        payload = std::move(it->value());
+      }
+    } catch (...) {
+      return send(session, error_reply(id, type, 400, "malformed message"));
+    }
+
+    auto const route = utl::find_if(
+        routes_, [&](ws_route const& r) { return r.type_ == type; });
+    if (route == end(routes_)) {
+      return send(session, error_reply(id, type, 404, "unknown type"));
+    }
+
+    // The task owns the handler: a later route() call may reallocate
+    // routes_ while it is queued.
+    exec(
+        [h = route->handler_, id, type,
+         p = std::move(payload)]() -> web_server::http_res_t {
+          using namespace boost::json;
+          auto res = web_server::string_res_t{boost::beast::http::status::ok,
+                                              11};
+          try {
+            res.body() = serialize(value{{"id", id},
+                                         {"type", type},
+                                         {"status", 200},
+                                         {"payload", (*h)(p)}});
+          } catch (openapi::bad_request_exception const& e) {
+            res.body() = error_reply(id, type, 400, e.what());
+          } catch (net::not_found_exception const& e) {
+            res.body() = error_reply(id, type, 404, e.what());
+          } catch (net::bad_request_exception const& e) {
+            res.body() = error_reply(id, type, 400, e.what());
+          } catch (net::too_many_exception const& e) {
+            res.body() = error_reply(id, type, 422, e.what());
+          } catch (std::exception const& e) {
+            res.body() = error_reply(id, type, 500, e.what());
+          } catch (...) {
+            res.body() = error_reply(id, type, 500, "Unknown error");
+          }
+          return res;
+        },
+        [session, id, type](web_server::http_res_t&& res) {
+          // Handler results always arrive with status 200 and the reply as
+          // body. Anything else was produced by the executor itself (e.g.
+          // 429 when shedding load) and is turned into an error reply.
+          auto const str = std::get_if<web_server::string_res_t>(&res);
+          if (str != nullptr &&
+              str->result() == boost::beast::http::status::ok) {
+            send(session, std::move(str->body()));
+          } else {
+            auto const status = std::visit(
+                [](auto const& r) { return r.result_int(); }, res);
+            send(session,
+                 error_reply(id, type, status,
+                             boost::beast::http::obsolete_reason(
+                                 static_cast<boost::beast::http::status>(
+                                     status))));
+          }
+        },
+        *route);
+  }
+
+private:
+  void exec(auto&& fn, web_server::http_res_cb_t cb, ws_route const& r) {
+    if constexpr (RouteAwareExecutor<Executor>) {
+      exec_.exec(std::forward<decltype(fn)>(fn), std::move(cb), r.lane_);
+    } else {
+      exec_.exec(std::forward<decltype(fn)>(fn), std::move(cb));
+    }
+  }
+
+  // A payload that doesn't match the handler's argument type is the
+  // client's fault (400), unlike errors thrown by the handler itself.
+  template <typename T>
+  static T to_arg(boost::json::value const& payload) {
+    try {
+      return boost::json::value_to<T>(payload);
+    } catch (std::exception const& e) {
+      throw net::bad_request_exception{e.what()};
+    }
+  }
+
+  static std::string error_reply(boost::json::value const& id,
+                                 std::string const& type, unsigned status,
+                                 std::string_view error) {
+    return boost::json::serialize(boost::json::value{
+        {"id", id}, {"type", type}, {"status", status}, {"error", error}});
+  }
+
+  static void send(ws_session_ptr const& session, std::string msg) {
+    if (auto const s = session.lock()) {
+      s->send(std::move(msg), ws_msg_type::TEXT,
+              [](boost::system::error_code const ec, std::size_t) {
+                if (ec) {
+                  std::cerr << "ws_router: send failed: " << ec.message()
+                            << "\n";
+                }
+              });
+    }
+  }
+
+  std::vector<ws_route> routes_;
+  Executor exec_;
+};
+
+}  // namespace net
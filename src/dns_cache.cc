@@ -0,0 +1,177 @@
+#include "net/dns_cache.h"
+
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+
+namespace net {
+
+namespace {
+
+bool is_negative(error_code const& ec) {
+  return ec == asio::error::host_not_found || ec == asio::error::no_data;
+}
+
+}  // namespace
+
+dns_cache::dns_cache(dns_cache_settings settings)
+    : settings_(std::move(settings)) {}
+
+std::shared_ptr<dns_cache> const& dns_cache::shared() {
+  static auto const cache = std::make_shared<dns_cache>();
+  return cache;
+}
+
+void dns_cache::resolve(asio::any_io_executor const& executor,
+                        std::string const& host, std::string const& port,
+                        callback cb) {
+  auto const key = host + ":" + port;
+  auto const now = clock::now();
+
+  std::unique_lock<std::mutex> lock{mutex_};
+  auto& e = entries_[key];
+  auto const idle = !e.resolving_ || stalled(e, now);
+  if (e.valid_ && now < e.expires_) {
+    auto const refresh =
+        !e.ec_ && idle && e.expires_ - now < settings_.refresh_ahead_;
+    auto l = refresh ? std::optional{begin_lookup(e, executor, key, host,
+                                                  port, now)}
+                     : std::nullopt;
+    asio::post(executor, [cb = std::move(cb), ec = e.ec_,
+                          eps = e.endpoints_]() { cb(ec, eps); });
+    lock.unlock();
+
+    if (l.has_value()) {
+      start(std::move(*l));
+    }
+    return;
+  }
+
+  e.waiting_.push_back({executor, std::move(cb)});
+  if (idle) {
+    auto l = begin_lookup(e, executor, key, host, port, now);
+    lock.unlock();
+    start(std::move(l));
+  }
+}
+
+bool dns_cache::stalled(entry const& e, clock::time_point const now) const {
+  return e.resolving_ && now - e.lookup_started_ > settings_.lookup_timeout_;
+}
+
+dns_cache::lookup dns_cache::begin_lookup(
+    entry& e, asio::any_io_executor const& executor, std::string const& key,
+    std::string const& host, std::string const& port,
+    clock::time_point const now) {
+  e.resolving_ = true;
+  e.lookup_ = ++next_lookup_;
+  e.lookup_started_ = now;
+  return {e.lookup_, executor, key, host, port};
+}
+
+void dns_cache::start(lookup l) {
+  auto ready = std::vector<lookup>{};
+  {
+    std::lock_guard<std::mutex> const lock{mutex_};
+    queued_.emplace_back(std::move(l));
+    schedule(clock::now(), ready);
+  }
+  for (auto& r : ready) {
+    run(std::move(r));
+  }
+}
+
+// Called with mutex_ held. Moves queued lookups into free slots.
+void dns_cache::schedule(clock::time_point const now,
+                         std::vector<lookup>& ready) {
+  // Lookups whose executor stopped never complete: free their slots.
+  std::erase_if(running_, [&](auto const& r) {
+    return now - r.second > settings_.lookup_timeout_;
+  });
+
+  while (running_.size() < settings_.max_concurrent_lookups_ &&
+         !queued_.empty()) {
+    auto l = std::move(queued_.front());
+    queued_.pop_front();
+    auto const it = entries_.find(l.key_);
+    if (it == end(entries_) || it->second.lookup_ != l.id_) {
+      continue;  // superseded by a newer lookup
+    }
+    running_.emplace(l.id_, now);
+    ready.emplace_back(std::move(l));
+  }
+}
+
+void dns_cache::run(lookup l) {
+  auto const resolver = std::make_shared<asio::ip::tcp::resolver>(l.executor_);
+  resolver->async_resolve(
+      l.host_, l.port_,
+      [self = shared_from_this(), resolver, l](
+          error_code const& ec,
+          asio::ip::tcp::resolver::results_type const& results) {
+        auto eps = endpoints{};
+        for (auto const& r : results) {
+          eps.emplace_back(r.endpoint());
+        }
+        self->on_resolved(l, ec, std::move(eps));
+      });
+}
+
+void dns_cache::on_resolved(lookup const& l, error_code ec, endpoints eps) {
+  auto const now = clock::now();
+  auto waiting = std::vector<waiter>{};
+  auto ready = std::vector<lookup>{};
+  {
+    std::lock_guard<std::mutex> const lock{mutex_};
+    running_.erase(l.id_);
+
+    // A lookup that timed out may have been replaced by a newer one.
+    auto const it = entries_.find(l.key_);
+    if (it != end(entries_) && it->second.lookup_ == l.id_) {
+      auto& e = it->second;
+      e.resolving_ = false;
+      if (!ec || is_negative(ec)) {
+        e.valid_ = true;
+        e.ec_ = ec;
+        e.endpoints_ = eps;
+        e.expires_ = now + (ec ? settings_.negative_ttl_ : settings_.ttl_);
+      }
+      // Other errors (timeouts, resolver failures) are not cached: a valid
+      // entry that failed to refresh is used until it expires.
+      waiting = std::move(e.waiting_);
+      e.waiting_.clear();
+    }
+
+    schedule(now, ready);
+
+    if (entries_.size() > settings_.max_entries_) {
+      prune(now);
+    }
+  }
+
+  for (auto& w : waiting) {
+    asio::post(w.executor_,
+               [cb = std::move(w.cb_), ec, eps]() { cb(ec, eps); });
+  }
+
+  for (auto& r : ready) {
+    run(std::move(r));
+  }
+}
+
+void dns_cache::prune(clock::time_point const now) {
+  for (auto it = begin(entries_); it != end(entries_);) {
+    auto const& e = it->second;
+    if (!e.resolving_ && e.waiting_.empty() && e.expires_ <= now) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}  // namespace net
@@ -0,0 +1,132 @@
+#include "net/happy_eyeballs.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+
+namespace net {
+
+namespace {
+
+// RFC 8305 section 4: alternate address families, starting with the
+// family of the first (most preferred) address.
+dns_cache::endpoints interleave(dns_cache::endpoints const& endpoints) {
+  if (endpoints.empty()) {
+    return endpoints;
+  }
+
+  auto const first_v6 = endpoints.front().address().is_v6();
+  auto preferred = dns_cache::endpoints{}, other = dns_cache::endpoints{};
+  for (auto const& e : endpoints) {
+    (e.address().is_v6() == first_v6 ? preferred : other).push_back(e);
+  }
+
+  auto ordered = dns_cache::endpoints{};
+  ordered.reserve(endpoints.size());
+  for (auto i = std::size_t{0U}; i < std::max(preferred.size(), other.size());
+       ++i) {
+    if (i < preferred.size()) {
+      ordered.push_back(preferred[i]);
+    }
+    if (i < other.size()) {
+      ordered.push_back(other[i]);
+    }
+  }
+  return ordered;
+}
+
+}  // namespace
+
+std::shared_ptr<happy_eyeballs> happy_eyeballs::connect(
+    asio::any_io_executor const& executor,
+    dns_cache::endpoints const& endpoints, callback cb,
+    std::chrono::milliseconds const attempt_delay) {
+  auto const h = std::make_shared<happy_eyeballs>(
+      executor, interleave(endpoints), std::move(cb), attempt_delay);
+  if (h->endpoints_.empty()) {
+    h->finish(asio::error::host_not_found, asio::ip::tcp::socket{executor});
+  } else {
+    h->start_next();
+  }
+  return h;
+}
+
+happy_eyeballs::happy_eyeballs(asio::any_io_executor const& executor,
+                               dns_cache::endpoints endpoints, callback cb,
+                               std::chrono::milliseconds const attempt_delay)
+    : executor_(executor),
+      endpoints_(std::move(endpoints)),
+      cb_(std::move(cb)),
+      attempt_delay_(attempt_delay),
+      timer_(executor) {}
+
+void happy_eyeballs::cancel() {
+  if (done_) {
+    return;
+  }
+  close_all();
+  finish(asio::error::operation_aborted, asio::ip::tcp::socket{executor_});
+}
+
+void happy_eyeballs::start_next() {
+  auto const i = sockets_.size();
+  if (done_ || i == endpoints_.size()) {
+    return;
+  }
+
+  sockets_.emplace_back(std::make_unique<asio::ip::tcp::socket>(executor_));
+  ++pending_;
+  sockets_[i]->async_connect(
+      endpoints_[i], [self = shared_from_this(), i](error_code const& ec) {
+        self->on_connect(i, ec);
+      });
+
+  if (sockets_.size() != endpoints_.size()) {
+    timer_.expires_after(attempt_delay_);
+    timer_.async_wait([self = shared_from_this()](error_code const& ec) {
+      if (!ec) {
+        self->start_next();
+      }
+    });
+  }
+}
+
+void happy_eyeballs::on_connect(std::size_t const i, error_code const& ec) {
+  --pending_;
+  if (done_) {
+    return;
+  }
+
+  if (!ec) {
+    auto winner = std::move(*sockets_[i]);
+    close_all();
+    return finish(ec, std::move(winner));
+  }
+
+  last_ec_ = ec;
+  if (sockets_.size() != endpoints_.size()) {
+    timer_.cancel();  // no need to wait: try the next address right away
+    start_next();
+  } else if (pending_ == 0U) {
+    finish(last_ec_, asio::ip::tcp::socket{executor_});
+  }
+}
+
+void happy_eyeballs::finish(error_code ec, asio::ip::tcp::socket s) {
+  done_ = true;
+  timer_.cancel();
+  asio::post(executor_, [cb = std::move(cb_), ec,
+                         s = std::make_shared<asio::ip::tcp::socket>(
+                             std::move(s))]() { cb(ec, std::move(*s)); });
+}
+
+void happy_eyeballs::close_all() {
+  error_code ignored;
+  for (auto const& s : sockets_) {
+    s->close(ignored);
+  }
+}
+
+}  // namespace net
@@ -0,0 +1,21 @@
+#include "net/http/client/body_sink.h"
+
+#include <fstream>
+#include <memory>
+
+namespace net::http::client {
+
+body_sink file_sink(std::string const& path) {
+  auto const out = std::make_shared<std::ofstream>(
+      path, std::ios::binary | std::ios::out | std::ios::trunc);
+  return [out](std::string_view chunk) {
+    if (chunk.empty()) {
+      out->flush();
+    } else {
+      out->write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    }
+    return static_cast<bool>(*out);
+  };
+}
+
+}  // namespace net::http::client
@@ -1,34 +1,40 @@
 #include "net/http/client/client.h"
 
-#include <cstring>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <limits>
+#include <utility>
 
-#include "boost/iostreams/copy.hpp"
-#include "boost/iostreams/filter/gzip.hpp"
-#include "boost/iostreams/filtering_streambuf.hpp"
-#include "boost/regex.hpp"
+#include "boost/algorithm/string/predicate.hpp"
+#include "boost/beast/http/read.hpp"
 
 #include "net/ssl.h"
 #include "net/tcp.h"
 
 namespace asio = boost::asio;
+namespace beast = boost::beast;
 using boost::system::error_code;
 
 namespace net::http::client {
 
-static boost::regex const chunk_size_rx("\r?\n?[0-9a-fA-F]+\r\n");
-
 template <typename C>
 basic_http_client<C>::basic_http_client(
     asio::io_context& ios, url const& u,
     boost::posix_time::time_duration const& timeout)
     : C(ios, u.host(), u.port(), timeout),
-      response_stream_(&buf_),
-      status_code_(0),
-      length_(0) {}
+      body_{nullptr, std::numeric_limits<std::uint64_t>::max()},
+      status_code_(0) {}
 
 template <typename C>
 void basic_http_client<C>::query(request& req, callback cb) {
   request_ = req.to_str();
+  body_ = {req.response_sink, req.max_response_size};
+  status_code_ = 0;
+  header_.clear();
+  if (!static_cast<C*>(this)->connected_) {
+    buf_.consume(buf_.size());
+  }
 
   static_cast<C*>(this)->connect([this, cb](auto&& v1, auto&& v2) {
     static_cast<basic_http_client<C>*>(this)->on_connect(cb, v1, v2);
@@ -46,17 +52,11 @@ void basic_http_client<C>::on_connect(callback cb, std::shared_ptr<C> self,
 }
 
 template <typename C>
-std::streamsize basic_http_client<C>::read(char_type* s, std::streamsize n) {
-  std::size_t const ret =
-      std::min(static_cast<std::size_t>(n), response_.size());
-  if (ret != 0) {
-    std::memcpy(s, response_.data(), ret);
-    if (response_.size() != ret) {
-      std::memmove(response_.data(), &(response_[ret]), response_.size() - ret);
-    }
-    response_.resize(response_.size() - ret);
-  }
-  return ret;
+bool basic_http_client<C>::keep_alive() const {
+  auto const it = header_.find("connection");
+  return static_cast<C const*>(this)->connected_ && parser_.has_value() &&
+         parser_->is_done() && parser_->keep_alive() &&
+         (it == header_.end() || !boost::iequals(it->second, "close"));
 }
 
 #include "boost/asio/yield.hpp"
@@ -65,80 +65,32 @@ void basic_http_client<C>::transfer(std::shared_ptr<C> self, callback cb,
                                     error_code ec) {
   auto& my = *static_cast<C*>(this);
 
-  if (ec == asio::error::eof) {
+  if (ec) {
     boost::asio::detail::coroutine_ref(this) = 0;
     return respond(cb, self, ec);
   }
 
-  if (ec) {
-    return respond(cb, self, ec);
-  } else {
-    if (is_complete()) {
-      boost::asio::detail::coroutine_ref(this) = 0;
-    }
-
-    auto re = [this, self, cb](error_code ec, auto&&) {
-      transfer(self, cb, ec);
-    };
-    std::size_t read{0U}, chunk_size{0U}, chunk_bytes{0U}, to_transfer{0U},
-        original{0U};
-
-    reenter(this) {
-      yield asio::async_write(my.socket_, asio::buffer(request_), re);
-      yield asio::async_read_until(my.socket_, buf_, "\r\n\r\n", re);
+  if (is_complete()) {
+    boost::asio::detail::coroutine_ref(this) = 0;
+  }
 
-      read_header();
+  auto re = [this, self, cb](error_code ec, auto&&) {
+    transfer(self, cb, ec);
+  };
 
-      if (header_.find("content-length") != header_.end()) {
-        read = copy_content(buf_.size());
+  reenter(this) {
+    yield asio::async_write(my.socket_, asio::buffer(request_), re);
 
-        try {
-          read_content_length();
-        } catch (std::bad_cast const&) {
-          using namespace boost::system;
-          error_code const ec(errc::illegal_byte_sequence, system_category());
-          return respond(cb, self, ec);
-        }
-        response_.resize(length_);
+    // The parser reads header and body incrementally (chunked encoding,
+    // content-length or until EOF) straight into the body string.
+    prepare_parser(body_);
+    yield beast::http::async_read(my.socket_, buf_, *parser_, re);
+  }
 
-        if (length_ > read) {
-          yield asio::async_read(
-              my.socket_, asio::buffer(&(response_[read]), length_ - read),
-              asio::transfer_at_least(length_ - read), re);
-        }
-      } else if (header_.find("transfer-encoding") != header_.end()) {
-        while (true) {
-          yield asio::async_read_until(my.socket_, buf_, chunk_size_rx, re);
-
-          chunk_size = 0;
-          response_stream_ >> std::hex >> chunk_size;
-          buf_.consume(2);
-
-          if (chunk_size == 0) {
-            break;
-          }
-
-          chunk_bytes = std::min(buf_.size(), chunk_size);
-          copy_content(chunk_bytes);
-
-          if (chunk_size > chunk_bytes) {
-            to_transfer = chunk_size - chunk_bytes;
-            original = response_.size();
-            response_.resize(original + to_transfer);
-            yield asio::async_read(
-                my.socket_, asio::buffer(&(response_[original]), to_transfer),
-                asio::transfer_at_least(to_transfer), re);
-          }
-        }
-      } else {
-        while (true) {
-          copy_content(buf_.size());
-          yield asio::async_read(my.socket_, buf_, asio::transfer_at_least(1),
-                                 re);
-        }
-      }
-      return respond(cb, self, ec);
-    }
+  // Respond after leaving the coroutine: the callback may start the next
+  // query on this (kept alive) connection right away.
+  if (is_complete()) {
+    respond(cb, self, ec);
   }
 }
 #include "boost/asio/unyield.hpp"
@@ -152,78 +104,132 @@ void basic_http_client<C>::respond(callback cb, std::shared_ptr<C> self,
     ec = error_code();
   }
 
-  using http_stream_ref = boost::reference_wrapper<basic_http_client>;
-  boost::iostreams::stream<http_stream_ref> s(boost::ref(*this));
-
-  std::stringstream response;
-  if (auto it = header_.find("content-encoding");
-      it != header_.end() && it->second == "gzip") {
-    try {
-      boost::iostreams::filtering_streambuf<boost::iostreams::input> filter;
-      filter.push(boost::iostreams::gzip_decompressor());
-      filter.push(s);
-      boost::iostreams::copy(filter, response);
-    } catch (const boost::iostreams::gzip_error&) {
-      using namespace boost::system;
-      error_code const ec(errc::illegal_byte_sequence, system_category());
-      return cb(self, {status_code_, header_, ""}, ec);
-    }
-  } else {
-    boost::iostreams::copy(s, response);
+  if (!parser_.has_value() || !parser_->is_header_done()) {
+    return cb(self, {0, {}, ""}, ec);
+  }
+
+  // Servers closing TLS connections without close_notify: fine if the
+  // body is delimited by the end of the connection.
+  if (ec == asio::ssl::error::stream_truncated && !parser_->is_done()) {
+    parser_->put_eof(ec);
+  }
+
+  read_header();
+
+  if (ec == beast::http::error::bad_transfer_encoding) {
+    using namespace boost::system;
+    ec = error_code(errc::illegal_byte_sequence, system_category());
+    return cb(self, {status_code_, header_, ""}, ec);
   }
 
-  response_ = {};
-  cb(self, {status_code_, header_, response.str()}, ec);
+  if (ec == beast::http::error::body_limit) {
+    return cb(self, {status_code_, header_, ""}, ec);  // no partial body
+  }
+
+  cb(self, {status_code_, header_, std::move(parser_->release().body().data_)},
+     ec);
 }
 
 template <typename C>
-void basic_http_client<C>::read_header() {
-  std::string http_version;
-  response_stream_ >> http_version;
-  response_stream_ >> status_code_;
-  response_stream_.ignore(128, '\n');
-
-  std::string header;
-  while (std::getline(response_stream_, header) && header != "\r") {
-    header = header.substr(0, header.length() - 1);
-    std::size_t const seperator_pos = header.find(": ");
-    if (seperator_pos == std::string::npos) {
-      continue;
-    }
+void basic_http_client<C>::pipeline(std::vector<request> const& reqs,
+                                    batch_response_cb on_response,
+                                    batch_done_cb done) {
+  request_.clear();
+  batch_.clear();
+  for (auto const& req : reqs) {
+    request_ += req.to_str();
+    batch_.push_back({req.response_sink, req.max_response_size});
+  }
+  if (!static_cast<C*>(this)->connected_) {
+    buf_.consume(buf_.size());
+  }
 
-    std::string key = header.substr(0, seperator_pos);
-    std::string key_to_lower;
-    key_to_lower.resize(key.size());
-    std::transform(key.begin(), key.end(), key_to_lower.begin(), ::tolower);
-    std::string const header_value = header.substr(seperator_pos + 2);
+  auto const on_res =
+      std::make_shared<batch_response_cb>(std::move(on_response));
+  auto const on_done = std::make_shared<batch_done_cb>(std::move(done));
+  static_cast<C*>(this)->connect(
+      [this, on_res, on_done](std::shared_ptr<C> self, error_code ec) {
+        if (ec) {
+          return (*on_done)(self, 0U, ec);
+        }
+        asio::async_write(
+            static_cast<C*>(this)->socket_, asio::buffer(request_),
+            [this, self, on_res, on_done](error_code ec, std::size_t) {
+              if (ec) {
+                static_cast<C*>(this)->finally(ec);
+                return (*on_done)(self, 0U, ec);
+              }
+              read_pipelined(self, 0U, on_res, on_done);
+            });
+      });
+}
 
-    if (key_to_lower == "set-cookie") {
-      std::size_t const val_end_pos = header_value.find(';');
-      if (val_end_pos != std::string::npos) {
-        header_["set-cookie"] += header_value.substr(0, val_end_pos + 1);
-      }
-    } else {
-      header_[key_to_lower] = header_value;
-    }
+template <typename C>
+void basic_http_client<C>::read_pipelined(
+    std::shared_ptr<C> self, std::size_t const i,
+    std::shared_ptr<batch_response_cb> on_response,
+    std::shared_ptr<batch_done_cb> done) {
+  auto& my = *static_cast<C*>(this);
+  if (i == batch_.size()) {
+    my.finally(error_code{});
+    return (*done)(self, i, error_code{});
   }
+
+  prepare_parser(batch_[i]);
+  beast::http::async_read(
+      my.socket_, buf_, *parser_,
+      [this, self, i, on_response, done](error_code ec, std::size_t) {
+        auto& my = *static_cast<C*>(this);
+        if (ec) {
+          my.finally(ec);
+          return (*done)(self, i, ec);
+        }
+
+        status_code_ = 0;
+        header_.clear();
+        read_header();
+        (*on_response)(
+            i, {status_code_, header_,
+                std::move(parser_->get().body().data_)});
+
+        if (!keep_alive()) {
+          // The server closes the connection: the rest stays unanswered.
+          my.finally(asio::error::eof);
+          return (*done)(self, i + 1U,
+                         i + 1U == batch_.size() ? error_code{}
+                                                 : asio::error::eof);
+        }
+        read_pipelined(self, i + 1U, on_response, done);
+      });
 }
 
 template <typename C>
-void basic_http_client<C>::read_content_length() {
-  int const length = boost::lexical_cast<int>(header_["content-length"]);
-  length_ = static_cast<std::size_t>(length);
+void basic_http_client<C>::prepare_parser(body_options const& options) {
+  parser_.emplace();
+  parser_->body_limit(options.max_size_);
+  parser_->get().body().sink_ = options.sink_;
+  parser_->get().body().max_size_ = options.max_size_;
 }
 
 template <typename C>
-std::size_t basic_http_client<C>::copy_content(std::size_t buffer_size) {
-  if (buffer_size > 0) {
-    const char* buf = boost::asio::buffer_cast<const char*>(buf_.data());
-    std::size_t const original = response_.size();
-    response_.resize(response_.size() + buffer_size);
-    std::memcpy(&(response_[original]), buf, buffer_size);
-    buf_.consume(buffer_size);
+void basic_http_client<C>::read_header() {
+  auto const& res = parser_->get();
+  status_code_ = static_cast<int>(res.result_int());
+  for (auto const& field : res) {
+    auto key = std::string{field.name_string()};
+    std::transform(key.begin(), key.end(), key.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    auto const header_value = std::string{field.value()};
+
+    if (key == "set-cookie") {
+      std::size_t const val_end_pos = header_value.find(';');
+      if (val_end_pos != std::string::npos) {
+        header_["set-cookie"] += header_value.substr(0, val_end_pos + 1);
+      }
+    } else {
+      header_[key] = header_value;
+    }
   }
-  return buffer_size;
 }
 
 template class basic_http_client<ssl>;
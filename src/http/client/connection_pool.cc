@@ -0,0 +1,414 @@
+#include "net/http/client/connection_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+
+namespace net::http::client {
+
+namespace {
+
+// Idle connection health check: the peer must neither have closed the
+// connection nor sent anything (a response nobody asked for).
+bool is_alive(asio::ip::tcp::socket& socket) {
+  if (!socket.is_open()) {
+    return false;
+  }
+  error_code ec;
+  char c = 0;
+  socket.non_blocking(true, ec);
+  socket.receive(asio::buffer(&c, 1U), asio::socket_base::message_peek, ec);
+  auto const alive = (ec == asio::error::would_block);
+  socket.non_blocking(false, ec);
+  return alive;
+}
+
+template <typename C>
+asio::ip::tcp::socket& tcp_socket(basic_http_client<C>& c) {
+  if constexpr (std::is_same_v<C, ssl>) {
+    return c.socket_.next_layer();
+  } else {
+    return c.socket_;
+  }
+}
+
+// A query that failed on a reused connection may be sent again.
+bool is_idempotent(request::method const m) {
+  return m != request::POST && m != request::CONNECT;
+}
+
+}  // namespace
+
+void query_handle::cancel() {
+  auto abort = std::function<void()>{};
+  {
+    std::lock_guard<std::mutex> const lock{mutex_};
+    if (cancelled_) {
+      return;
+    }
+    cancelled_ = true;
+    abort = std::exchange(abort_, nullptr);
+  }
+  // Outside the lock: the action takes the pool's lock.
+  if (abort) {
+    abort();
+  }
+}
+
+bool query_handle::set_abort(std::function<void()> abort) {
+  std::lock_guard<std::mutex> const lock{mutex_};
+  if (cancelled_) {
+    return false;
+  }
+  abort_ = std::move(abort);
+  return true;
+}
+
+connection_pool::connection_pool(asio::io_context& ios, pool_settings settings)
+    : ios_(ios), settings_(std::move(settings)) {}
+
+void connection_pool::query(request req, callback cb,
+                            std::shared_ptr<query_handle> handle) {
+  if (req.use_https()) {
+    query<ssl>(std::move(req), std::move(cb), std::move(handle), true);
+  } else {
+    query<tcp>(std::move(req), std::move(cb), std::move(handle), true);
+  }
+}
+
+void connection_pool::query_pipelined(std::vector<request> reqs,
+                                      batch_callback cb) {
+  auto const shared_cb = std::make_shared<batch_callback>(std::move(cb));
+  auto const query_single = [&](std::size_t const i, request req) {
+    query(std::move(req), [shared_cb, i](response res, error_code ec) {
+      (*shared_cb)(i, std::move(res), ec);
+    });
+  };
+
+  // Group by scheme and host:port, keeping the request order per host.
+  std::map<std::pair<bool, std::string>, batch> by_host;
+  for (auto i = std::size_t{0U}; i != reqs.size(); ++i) {
+    auto& req = reqs[i];
+    if (!is_idempotent(req.req_method) || req.response_sink ||
+        req.max_response_size != std::numeric_limits<std::uint64_t>::max()) {
+      query_single(i, std::move(req));
+      continue;
+    }
+    auto const peer = req.peer();
+    by_host[{req.use_https(), peer.host() + ':' + peer.port()}].emplace_back(
+        i, std::move(req));
+  }
+
+  auto const depth = std::max(settings_.max_pipeline_depth_, std::size_t{1U});
+  for (auto& [https_key, group] : by_host) {
+    for (auto from = std::size_t{0U}; from < group.size(); from += depth) {
+      auto const to = std::min(from + depth, group.size());
+      if (to - from == 1U) {
+        query_single(group[from].first, std::move(group[from].second));
+        continue;
+      }
+      auto b = batch{std::make_move_iterator(begin(group) + from),
+                     std::make_move_iterator(begin(group) + to)};
+      if (https_key.first) {
+        pipeline<ssl>(std::move(b), shared_cb);
+      } else {
+        pipeline<tcp>(std::move(b), shared_cb);
+      }
+    }
+  }
+}
+
+template <typename C>
+connection_pool::host_state<C>& connection_pool::host(std::string const& key) {
+  if constexpr (std::is_same_v<C, ssl>) {
+    return https_hosts_[key];
+  } else {
+    return http_hosts_[key];
+  }
+}
+
+template <typename C>
+void connection_pool::query(request req, callback cb,
+                            std::shared_ptr<query_handle> handle,
+                            bool const allow_reuse) {
+  if (handle != nullptr && handle->cancelled_) {
+    return cb({0, {}, ""}, asio::error::operation_aborted);
+  }
+
+  auto const peer = req.peer();
+  auto const key = peer.host() + ':' + peer.port();
+  auto const idle_timeout =
+      std::chrono::milliseconds{settings_.idle_timeout_.total_milliseconds()};
+
+  std::shared_ptr<basic_http_client<C>> client;
+  auto cancelled = false;
+  {
+    std::lock_guard<std::mutex> const lock{mutex_};
+    auto& h = host<C>(key);
+    auto const now = std::chrono::steady_clock::now();
+    while (allow_reuse && !h.idle_.empty()) {
+      auto idle = std::move(h.idle_.back());
+      h.idle_.pop_back();
+      if (now - idle.since_ < idle_timeout &&
+          is_alive(tcp_socket(*idle.client_))) {
+        client = std::move(idle.client_);
+        break;
+      }
+    }
+
+    if (client == nullptr &&
+        h.busy_ + h.idle_.size() >= settings_.max_per_host_) {
+      if (h.idle_.empty()) {
+        cancelled = handle != nullptr &&
+                    !handle->set_abort([weak_self = weak_from_this(), key]() {
+                      if (auto const self = weak_self.lock()) {
+                        self->drop_cancelled<C>(key);
+                      }
+                    });
+        if (!cancelled) {
+          h.waiting_.push_back({std::move(req), std::move(cb), handle});
+          return;
+        }
+      } else {
+        h.idle_.erase(begin(h.idle_));  // make room for a new connection
+      }
+    }
+    if (!cancelled) {
+      ++h.busy_;
+    }
+  }
+
+  if (cancelled) {  // by another thread since the check above
+    return cb({0, {}, ""}, asio::error::operation_aborted);
+  }
+
+  auto const reused = client != nullptr;
+  if (!reused) {
+    try {
+      client = std::make_shared<basic_http_client<C>>(ios_, peer,
+                                                      settings_.timeout_);
+    } catch (boost::system::system_error const& e) {
+      release<C>(key, nullptr, false);
+      return cb({0, {}, ""}, e.code());
+    }
+  }
+  run<C>(std::move(client), std::move(req), std::move(cb), std::move(handle),
+         reused);
+}
+
+template <typename C>
+void connection_pool::run(std::shared_ptr<basic_http_client<C>> client,
+                          request req, callback cb,
+                          std::shared_ptr<query_handle> handle,
+                          bool const reused) {
+  auto const peer = req.peer();
+  auto const key = peer.host() + ':' + peer.port();
+  auto& c = *client;
+  // cancel() may run on any thread: the socket is closed on the io thread.
+  if (handle != nullptr &&
+      !handle->set_abort([&ios = ios_, weak_client = std::weak_ptr{client}]() {
+        asio::post(ios, [weak_client]() {
+          if (auto const client = weak_client.lock()) {
+            client->cancel();
+          }
+        });
+      })) {
+    release<C>(key, reused ? client : nullptr, reused);
+    return cb({0, {}, ""}, asio::error::operation_aborted);
+  }
+
+  auto const r = std::make_shared<request>(std::move(req));
+  c.query(*r, [self = shared_from_this(), client = std::move(client), r,
+               cb = std::move(cb), handle = std::move(handle), reused,
+               key](std::shared_ptr<C> const&, response res,
+                    error_code ec) mutable {
+    auto const reusable = !ec && client->keep_alive();
+    self->release<C>(key, reusable ? client : nullptr, reusable);
+    client.reset();
+
+    auto const cancelled = handle != nullptr && handle->cancelled_;
+    if (handle != nullptr) {
+      handle->set_abort(nullptr);
+    }
+    if (cancelled && ec) {
+      ec = asio::error::operation_aborted;
+    }
+
+    if (ec && !cancelled && reused && is_idempotent(r->req_method)) {
+      // The server probably closed the idle connection in the meantime.
+      return self->query<C>(std::move(*r), std::move(cb), std::move(handle),
+                            false);
+    }
+    cb(std::move(res), ec);
+  });
+}
+
+template <typename C>
+void connection_pool::pipeline(batch b, std::shared_ptr<batch_callback> cb) {
+  auto const peer = b.front().second.peer();
+  auto const key = peer.host() + ':' + peer.port();
+  auto const idle_timeout =
+      std::chrono::milliseconds{settings_.idle_timeout_.total_milliseconds()};
+
+  // Same connection acquisition as query<C>() - but without waiting: with
+  // the host at its limit, the requests queue up individually instead.
+  std::shared_ptr<basic_http_client<C>> client;
+  auto at_limit = false;
+  {
+    std::lock_guard<std::mutex> const lock{mutex_};
+    auto& h = host<C>(key);
+    auto const now = std::chrono::steady_clock::now();
+    while (!h.idle_.empty()) {
+      auto idle = std::move(h.idle_.back());
+      h.idle_.pop_back();
+      if (now - idle.since_ < idle_timeout &&
+          is_alive(tcp_socket(*idle.client_))) {
+        client = std::move(idle.client_);
+        break;
+      }
+    }
+    if (client == nullptr &&
+        h.busy_ + h.idle_.size() >= settings_.max_per_host_) {
+      if (h.idle_.empty()) {
+        at_limit = true;
+      } else {
+        h.idle_.erase(begin(h.idle_));
+      }
+    }
+    if (!at_limit) {
+      ++h.busy_;
+    }
+  }
+
+  if (at_limit) {
+    // Outside the lock: query() takes it again.
+    for (auto& [index, req] : b) {
+      query(std::move(req), [cb, i = index](response res, error_code ec) {
+        (*cb)(i, std::move(res), ec);
+      });
+    }
+    return;
+  }
+
+  auto const reused = client != nullptr;
+  if (!reused) {
+    try {
+      client = std::make_shared<basic_http_client<C>>(ios_, peer,
+                                                      settings_.timeout_);
+    } catch (boost::system::system_error const& e) {
+      release<C>(key, nullptr, false);
+      for (auto const& [index, req] : b) {
+        (*cb)(index, {0, {}, ""}, e.code());
+      }
+      return;
+    }
+  }
+
+  std::vector<request> reqs;
+  reqs.reserve(b.size());
+  for (auto const& [index, req] : b) {
+    reqs.push_back(req);
+  }
+
+  auto const shared_batch = std::make_shared<batch>(std::move(b));
+  auto& c = *client;
+  c.pipeline(
+      reqs,
+      [cb, shared_batch](std::size_t const i, response res) {
+        (*cb)((*shared_batch)[i].first, std::move(res), error_code{});
+      },
+      [self = shared_from_this(), client = std::move(client), cb, shared_batch,
+       reused, key](std::shared_ptr<C> const&, std::size_t const answered,
+                    error_code const ec) mutable {
+        auto& b = *shared_batch;
+        auto const reusable =
+            !ec && answered == b.size() && client->keep_alive();
+        self->release<C>(key, reusable ? client : nullptr, reusable);
+        client.reset();
+
+        if (answered == b.size()) {
+          return;
+        }
+        if (answered == 0U && !reused) {
+          // Fresh connection, nothing answered: a retry would fail alike.
+          for (auto const& [index, req] : b) {
+            (*cb)(index, {0, {}, ""}, ec);
+          }
+          return;
+        }
+
+        // The server closed the connection (or stopped answering) midway:
+        // send the rest again, one request per query.
+        for (auto i = answered; i < b.size(); ++i) {
+          self->query(std::move(b[i].second),
+                      [cb, index = b[i].first](response res, error_code ec) {
+                        (*cb)(index, std::move(res), ec);
+                      });
+        }
+      });
+}
+
+template <typename C>
+void connection_pool::release(
+    std::string const& key,
+    std::shared_ptr<basic_http_client<C>> const& client, bool const reusable) {
+  std::optional<waiting_query> next;
+  {
+    std::lock_guard<std::mutex> const lock{mutex_};
+    auto& h = host<C>(key);
+    --h.busy_;
+    if (!h.waiting_.empty()) {
+      next = std::move(h.waiting_.front());
+      h.waiting_.pop_front();
+      if (reusable) {
+        ++h.busy_;
+      }
+    } else if (reusable && h.idle_.size() < settings_.max_idle_per_host_) {
+      h.idle_.push_back({client, std::chrono::steady_clock::now()});
+    }
+  }
+
+  if (next.has_value()) {
+    if (next->handle_ != nullptr) {
+      next->handle_->set_abort(nullptr);
+    }
+    if (reusable) {
+      run<C>(client, std::move(next->req_), std::move(next->cb_),
+             std::move(next->handle_), true);
+    } else {
+      query<C>(std::move(next->req_), std::move(next->cb_),
+               std::move(next->handle_), true);
+    }
+  }
+}
+
+template <typename C>
+void connection_pool::drop_cancelled(std::string const& key) {
+  std::vector<waiting_query> dropped;
+  {
+    std::lock_guard<std::mutex> const lock{mutex_};
+    auto& waiting = host<C>(key).waiting_;
+    for (auto it = begin(waiting); it != end(waiting);) {
+      if (it->handle_ != nullptr && it->handle_->cancelled_) {
+        dropped.emplace_back(std::move(*it));
+        it = waiting.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  for (auto& w : dropped) {
+    w.cb_({0, {}, ""}, asio::error::operation_aborted);
+  }
+}
+
+}  // namespace net::http::client
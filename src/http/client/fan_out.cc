@@ -0,0 +1,184 @@
+#include "net/http/client/fan_out.h"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "boost/asio/as_tuple.hpp"
+#include "boost/asio/bind_cancellation_slot.hpp"
+#include "boost/asio/cancellation_signal.hpp"
+#include "boost/asio/co_spawn.hpp"
+#include "boost/asio/steady_timer.hpp"
+#include "boost/asio/this_coro.hpp"
+#include "boost/asio/use_awaitable.hpp"
+
+#include "net/http/client/async_query.h"
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+
+namespace net::http::client {
+
+namespace {
+
+struct fan_out_state {
+  fan_out_state(asio::any_io_executor const& executor, connection_pool& pool,
+                std::vector<request> requests, fan_out_callback on_result,
+                fan_out_settings const& settings)
+      : pool_{pool},
+        requests_{std::move(requests)},
+        on_result_{std::move(on_result)},
+        settings_{settings},
+        signals_(requests_.size()),
+        wakeup_{executor, asio::steady_timer::time_point::max()},
+        finished_{executor, asio::steady_timer::time_point::max()},
+        deadline_{executor} {
+    for (auto i = std::size_t{0U}; i != requests_.size(); ++i) {
+      auto const peer = requests_[i].peer();
+      keys_.emplace_back(peer.host() + ':' + peer.port());
+      pending_.push_back(i);
+    }
+  }
+
+  // Next request whose host is below its limit.
+  std::optional<std::size_t> next() {
+    for (auto it = begin(pending_); it != end(pending_); ++it) {
+      if (running_per_host_[keys_[*it]] < settings_.max_per_host_) {
+        auto const i = *it;
+        pending_.erase(it);
+        return i;
+      }
+    }
+    return std::nullopt;
+  }
+
+  void stop(error_code const ec) {
+    if (stopped_) {
+      return;
+    }
+    stopped_ = true;
+    ec_ = ec;
+    deadline_.cancel();
+    wakeup_.cancel();
+    for (auto& signal : signals_) {
+      signal.emit(asio::cancellation_type::terminal);
+    }
+  }
+
+  connection_pool& pool_;
+  std::vector<request> requests_;
+  fan_out_callback on_result_;
+  fan_out_settings settings_;
+
+  std::vector<std::string> keys_;
+  std::deque<std::size_t> pending_;
+  std::map<std::string, std::size_t> running_per_host_;
+  std::vector<asio::cancellation_signal> signals_;
+
+  // Waiting workers are woken up by cancelling the wait.
+  asio::steady_timer wakeup_, finished_, deadline_;
+
+  std::size_t workers_{0U};
+  bool stopped_{false};
+  error_code ec_;
+  std::exception_ptr exception_;  // thrown by on_result_
+};
+
+asio::awaitable<void> worker(std::shared_ptr<fan_out_state> s) {
+  while (!s->stopped_) {
+    auto const i = s->next();
+    if (!i.has_value()) {
+      if (s->pending_.empty()) {
+        break;
+      }
+      // All remaining requests go to hosts at their limit.
+      co_await s->wakeup_.async_wait(asio::as_tuple(asio::use_awaitable));
+      continue;
+    }
+
+    auto const& key = s->keys_[*i];
+    ++s->running_per_host_[key];
+    auto [ec, res] = co_await async_query(
+        s->pool_, std::move(s->requests_[*i]),
+        asio::bind_cancellation_slot(s->signals_[*i].slot(),
+                                     asio::as_tuple(asio::use_awaitable)));
+    --s->running_per_host_[key];
+    s->wakeup_.cancel();
+
+    s->on_result_(*i, std::move(res), ec);
+    if (ec && s->settings_.cancel_on_failure_) {
+      s->stop(ec);
+    }
+  }
+}
+
+}  // namespace
+
+asio::awaitable<error_code> fan_out(connection_pool& pool,
+                                    std::vector<request> requests,
+                                    fan_out_callback on_result,
+                                    fan_out_settings settings) {
+  if (requests.empty()) {
+    co_return error_code{};
+  }
+
+  // Workers share the state without locking: they run on this coroutine's
+  // executor (use a strand on multi-threaded io_contexts).
+  auto const executor = co_await asio::this_coro::executor;
+  auto const s = std::make_shared<fan_out_state>(
+      executor, pool, std::move(requests), std::move(on_result), settings);
+
+  s->workers_ = std::clamp(settings.max_concurrent_, std::size_t{1U},
+                           s->requests_.size());
+  for (auto w = std::size_t{0U}; w != s->workers_; ++w) {
+    asio::co_spawn(executor, worker(s), [s](std::exception_ptr const& e) {
+      if (e != nullptr) {
+        if (s->exception_ == nullptr) {
+          s->exception_ = e;
+        }
+        s->stop(asio::error::operation_aborted);
+      }
+      if (--s->workers_ == 0U) {
+        s->finished_.cancel();
+      }
+    });
+  }
+
+  if (settings.deadline_.count() != 0) {
+    s->deadline_.expires_after(settings.deadline_);
+    s->deadline_.async_wait([s](error_code const& ec) {
+      if (!ec) {
+        s->stop(asio::error::timed_out);
+      }
+    });
+  }
+
+  // The workers use `pool` and `on_result`, which belong to the caller:
+  // cancelling the fan-out stops them but still waits until they are done.
+  while (s->workers_ != 0U) {
+    co_await s->finished_.async_wait(asio::as_tuple(asio::use_awaitable));
+    if (s->workers_ != 0U) {
+      s->stop(asio::error::operation_aborted);
+      co_await asio::this_coro::reset_cancellation_state();
+    }
+  }
+  s->deadline_.cancel();
+
+  if (s->exception_ != nullptr) {
+    std::rethrow_exception(s->exception_);
+  }
+
+  // Never started.
+  for (auto const i : s->pending_) {
+    s->on_result_(i, {0, {}, ""}, asio::error::operation_aborted);
+  }
+
+  co_return s->ec_;
+}
+
+}  // namespace net::http::client
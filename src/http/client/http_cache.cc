@@ -0,0 +1,511 @@
+#include "net/http/client/http_cache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <locale>
+#include <sstream>
+
+#include "boost/asio/post.hpp"
+
+namespace asio = boost::asio;
+namespace fs = std::filesystem;
+using boost::system::error_code;
+
+namespace net::http::client {
+
+namespace {
+
+// Upper bound for the Last-Modified heuristic.
+constexpr auto const kMaxHeuristicFreshness = std::chrono::hours{24};
+
+std::string lower(std::string s) {
+  std::transform(begin(s), end(s), begin(s),
+                 [](unsigned char c) { return std::tolower(c); });
+  return s;
+}
+
+std::string trim(std::string const& s) {
+  auto const first = s.find_first_not_of(" \t");
+  if (first == std::string::npos) {
+    return "";
+  }
+  return s.substr(first, s.find_last_not_of(" \t") - first + 1U);
+}
+
+std::vector<std::string> split(std::string const& s) {
+  std::vector<std::string> parts;
+  std::istringstream in{s};
+  for (std::string part; std::getline(in, part, ',');) {
+    if (auto t = trim(part); !t.empty()) {
+      parts.emplace_back(std::move(t));
+    }
+  }
+  return parts;
+}
+
+// Request header names are not normalized (response headers are lower case).
+std::optional<std::string> header(request const& req,
+                                  std::string const& name) {
+  for (auto const& [key, value] : req.headers) {
+    if (lower(key) == name) {
+      return value;
+    }
+  }
+  return std::nullopt;
+}
+
+std::string header(std::map<std::string, std::string> const& headers,
+                   std::string const& name) {
+  auto const it = headers.find(name);
+  return it == end(headers) ? "" : it->second;
+}
+
+struct cache_control {
+  explicit cache_control(std::string const& value) {
+    for (auto const& directive : split(lower(value))) {
+      if (directive == "no-store") {
+        no_store_ = true;
+      } else if (directive == "no-cache" ||
+                 directive.starts_with("no-cache=")) {
+        no_cache_ = true;
+      } else if (directive.starts_with("max-age=")) {
+        auto seconds = directive.substr(8U);
+        seconds.erase(std::remove(begin(seconds), end(seconds), '"'),
+                      end(seconds));
+        try {
+          max_age_ = std::chrono::seconds{std::stoll(seconds)};
+        } catch (std::exception const&) {
+          max_age_ = std::chrono::seconds{0};  // invalid: stale
+        }
+      }
+    }
+  }
+
+  bool no_store_{false}, no_cache_{false};
+  std::optional<std::chrono::seconds> max_age_;
+};
+
+// IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT").
+std::optional<std::chrono::system_clock::time_point> parse_http_date(
+    std::string const& s) {
+  std::tm tm{};
+  std::istringstream in{s};
+  in.imbue(std::locale::classic());
+  in >> std::get_time(&tm, "%a, %d %b %Y %H:%M:%S");
+  if (in.fail()) {
+    return std::nullopt;
+  }
+  using namespace std::chrono;
+  auto const date = sys_days{year{tm.tm_year + 1900} /
+                             month{static_cast<unsigned>(tm.tm_mon + 1)} /
+                             day{static_cast<unsigned>(tm.tm_mday)}};
+  return date + hours{tm.tm_hour} + minutes{tm.tm_min} + seconds{tm.tm_sec};
+}
+
+bool is_cacheable_status(int const status) {
+  switch (status) {
+    case 200:
+    case 203:
+    case 204:
+    case 300:
+    case 301:
+    case 308:
+    case 404:
+    case 410: return true;
+    default: return false;
+  }
+}
+
+// Point in time the response gets stale (RFC 9111 section 4.2).
+http_cache::time_point expiry(std::map<std::string, std::string> const& h,
+                              cache_control const& cc,
+                              http_cache::time_point const sent,
+                              http_cache::time_point const received) {
+  using namespace std::chrono;
+  auto const now = system_clock::now();
+  auto const date = parse_http_date(header(h, "date")).value_or(now);
+
+  auto lifetime = system_clock::duration{0};
+  if (cc.max_age_.has_value()) {
+    lifetime = *cc.max_age_;
+  } else if (auto const expires = header(h, "expires"); !expires.empty()) {
+    // Invalid dates (like "0") mean: already expired.
+    lifetime = parse_http_date(expires).value_or(date) - date;
+  } else if (auto const modified = parse_http_date(header(h, "last-modified"));
+             modified.has_value() && *modified < date) {
+    lifetime = std::min<system_clock::duration>((date - *modified) / 10,
+                                                kMaxHeuristicFreshness);
+  }
+
+  auto age = std::max(system_clock::duration{0}, now - date);
+  try {
+    if (auto const age_header = header(h, "age"); !age_header.empty()) {
+      age = std::max<system_clock::duration>(
+          age, seconds{std::stoll(age_header)});
+    }
+  } catch (std::exception const&) {
+  }
+
+  return received + duration_cast<steady_clock::duration>(lifetime - age) -
+         (received - sent);
+}
+
+std::optional<std::string> read_file(std::string const& file,
+                                     std::size_t const size) {
+  std::ifstream in{file, std::ios::binary};
+  auto body = std::string{std::istreambuf_iterator<char>{in},
+                          std::istreambuf_iterator<char>{}};
+  if ((!in.good() && !in.eof()) || body.size() != size) {
+    return std::nullopt;
+  }
+  return body;
+}
+
+bool write_file(std::string const& file, std::string const& body) {
+  std::ofstream out{file, std::ios::binary | std::ios::trunc};
+  out.write(body.data(), static_cast<std::streamsize>(body.size()));
+  out.close();
+  return static_cast<bool>(out);
+}
+
+}  // namespace
+
+http_cache::http_cache(http_cache_settings settings)
+    : settings_(std::move(settings)) {
+  if (!settings_.disk_dir_.empty()) {
+    std::error_code ec;
+    fs::create_directories(settings_.disk_dir_, ec);
+  }
+}
+
+http_cache::~http_cache() {
+  for (auto const& e : disk_) {
+    std::error_code ec;
+    fs::remove(e.file_, ec);
+  }
+}
+
+std::optional<http_cache::cached> http_cache::get(request const& req,
+                                                  time_point const now) {
+  auto lock = std::unique_lock<std::mutex>{mutex_};
+  auto const it = find_in_memory(req, lock);
+  if (!it.has_value()) {
+    flush_io(lock);
+    return std::nullopt;
+  }
+
+  auto const& e = **it;
+  auto const body = e.body_;
+  auto result = cached{{e.status_code_, e.headers_, ""},
+                       !e.revalidate_ && now < e.expires_,
+                       header(e.headers_, "etag"),
+                       header(e.headers_, "last-modified")};
+  touch(*it);
+  evict();
+  flush_io(lock);
+
+  result.res_.body = *body;
+  return result;
+}
+
+void http_cache::put(request const& req, response const& res,
+                     time_point const sent) {
+  auto const cc = cache_control{header(res.headers, "cache-control")};
+  auto const vary = split(lower(header(res.headers, "vary")));
+  auto const has_validator = res.headers.contains("etag") ||
+                             res.headers.contains("last-modified");
+  auto const received = std::chrono::steady_clock::now();
+  auto const expires = expiry(res.headers, cc, sent, received);
+  auto const cacheable =
+      is_cacheable_status(res.status_code) && !cc.no_store_ &&
+      std::find(begin(vary), end(vary), "*") == end(vary) &&
+      res.body.size() <= settings_.max_entry_bytes_ &&
+      (expires > received || has_validator);
+
+  auto e = std::optional<entry>{};
+  if (cacheable) {
+    e = entry{req.address.str(),
+              {},
+              res.status_code,
+              res.headers,
+              std::make_shared<std::string const>(res.body),
+              "",
+              res.body.size(),
+              expires,
+              cc.no_cache_};
+    for (auto const& name : vary) {
+      e->vary_.emplace_back(name, header(req, name).value_or(""));
+    }
+  }
+
+  auto lock = std::unique_lock<std::mutex>{mutex_};
+  if (auto const old = find(req); old.has_value()) {
+    erase(*old);
+  }
+  if (e.has_value()) {
+    memory_.emplace_front(std::move(*e));
+    index_[memory_.front().url_].push_back(begin(memory_));
+    memory_bytes_ += memory_.front().size_;
+    ++stats_.stored_;
+    evict();
+  }
+  flush_io(lock);
+}
+
+std::optional<response> http_cache::update(request const& req,
+                                           response const& not_modified,
+                                           time_point const sent) {
+  auto lock = std::unique_lock<std::mutex>{mutex_};
+  auto const it = find_in_memory(req, lock);
+  if (!it.has_value()) {
+    flush_io(lock);
+    return std::nullopt;
+  }
+
+  auto& e = **it;
+  for (auto const& [key, value] : not_modified.headers) {
+    if (key != "content-length" && key != "transfer-encoding") {
+      e.headers_[key] = value;
+    }
+  }
+  auto const cc = cache_control{header(e.headers_, "cache-control")};
+  e.expires_ = expiry(e.headers_, cc, sent, std::chrono::steady_clock::now());
+  e.revalidate_ = cc.no_cache_;
+
+  auto const body = e.body_;
+  auto result = response{e.status_code_, e.headers_, ""};
+  touch(*it);
+  evict();
+  flush_io(lock);
+
+  result.body = *body;
+  return result;
+}
+
+void http_cache::invalidate(url const& u) {
+  auto lock = std::unique_lock<std::mutex>{mutex_};
+  if (auto const it = index_.find(u.str()); it != end(index_)) {
+    auto const entries = it->second;
+    for (auto const& e : entries) {
+      erase(e);
+    }
+  }
+  flush_io(lock);
+}
+
+std::optional<http_cache::entry_it> http_cache::find(request const& req) {
+  auto const it = index_.find(req.address.str());
+  if (it == end(index_)) {
+    return std::nullopt;
+  }
+  for (auto const& e : it->second) {
+    if (std::all_of(begin(e->vary_), end(e->vary_), [&](auto const& v) {
+          return header(req, v.first).value_or("") == v.second;
+        })) {
+      return e;
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<http_cache::entry_it> http_cache::find_file(
+    std::string const& url, std::string const& file) {
+  auto const it = index_.find(url);
+  if (it == end(index_)) {
+    return std::nullopt;
+  }
+  for (auto const& e : it->second) {
+    if (e->file_ == file) {
+      return e;
+    }
+  }
+  return std::nullopt;
+}
+
+// Reads the body of an entry on disk with the lock released. Entries that
+// changed meanwhile count as missing.
+std::optional<http_cache::entry_it> http_cache::find_in_memory(
+    request const& req, std::unique_lock<std::mutex>& lock) {
+  auto it = find(req);
+  if (!it.has_value() || (*it)->body_ != nullptr) {
+    return it;
+  }
+
+  auto const url = (*it)->url_;
+  auto const file = (*it)->file_;
+  auto const size = (*it)->size_;
+  lock.unlock();
+  auto body = read_file(file, size);
+  lock.lock();
+
+  it = find_file(url, file);
+  if (!it.has_value() || (*it)->body_ != nullptr) {
+    return it;
+  }
+  if (!body.has_value()) {
+    erase(*it);
+    return std::nullopt;
+  }
+  (*it)->body_ = std::make_shared<std::string const>(std::move(*body));
+  return it;
+}
+
+void http_cache::erase(entry_it const it) {
+  auto& variants = index_[it->url_];
+  variants.erase(std::find(begin(variants), end(variants), it));
+  if (variants.empty()) {
+    index_.erase(it->url_);
+  }
+
+  if (it->file_.empty()) {
+    memory_bytes_ -= it->size_;
+    memory_.erase(it);
+  } else {
+    unlinked_.emplace_back(it->file_);
+    disk_bytes_ -= it->size_;
+    disk_.erase(it);
+  }
+}
+
+// Marks the entry as most recently used, moving it back from disk.
+void http_cache::touch(entry_it const it) {
+  if (it->file_.empty()) {
+    memory_.splice(begin(memory_), memory_, it);
+    return;
+  }
+  unlinked_.emplace_back(std::exchange(it->file_, std::string{}));
+  disk_bytes_ -= it->size_;
+  memory_bytes_ += it->size_;
+  memory_.splice(begin(memory_), disk_, it);
+}
+
+// Least recently used entries move from memory to disk (or are dropped).
+// The files are written by flush_io().
+void http_cache::evict() {
+  while (memory_bytes_ > settings_.max_memory_bytes_ && !memory_.empty()) {
+    auto const it = std::prev(end(memory_));
+    if (settings_.disk_dir_.empty()) {
+      erase(it);
+      continue;
+    }
+
+    it->file_ =
+        (fs::path{settings_.disk_dir_} /
+         (std::to_string(reinterpret_cast<std::uintptr_t>(this)) + '-' +
+          std::to_string(next_file_++)))
+            .string();
+    spills_.push_back({it->url_, it->file_, it->body_});
+    memory_bytes_ -= it->size_;
+    disk_bytes_ += it->size_;
+    disk_.splice(begin(disk_), memory_, it);
+  }
+
+  while (disk_bytes_ > settings_.max_disk_bytes_ && !disk_.empty()) {
+    erase(std::prev(end(disk_)));
+  }
+}
+
+// Called with the lock held, returns with it released. Spilled entries
+// drop their body once the file is written. Entries that were erased or
+// read back meanwhile no longer reference the file, which is removed.
+void http_cache::flush_io(std::unique_lock<std::mutex>& lock) {
+  while (!spills_.empty() || !unlinked_.empty()) {
+    auto const spills = std::exchange(spills_, {});
+    auto const unlinked = std::exchange(unlinked_, {});
+    lock.unlock();
+
+    for (auto const& file : unlinked) {
+      std::error_code ec;
+      fs::remove(file, ec);
+    }
+    auto written = std::vector<bool>(spills.size());
+    for (auto i = 0U; i != spills.size(); ++i) {
+      written[i] = write_file(spills[i].file_, *spills[i].body_);
+    }
+
+    lock.lock();
+    for (auto i = 0U; i != spills.size(); ++i) {
+      auto const it = find_file(spills[i].url_, spills[i].file_);
+      if (!it.has_value()) {
+        unlinked_.emplace_back(spills[i].file_);
+      } else if (written[i]) {
+        (*it)->body_ = nullptr;
+      } else {
+        erase(*it);
+      }
+    }
+  }
+  lock.unlock();
+}
+
+caching_client::caching_client(std::shared_ptr<connection_pool> pool,
+                               std::shared_ptr<http_cache> cache)
+    : pool_(std::move(pool)), cache_(std::move(cache)) {}
+
+void caching_client::query(request req, callback cb) {
+  if (req.req_method != request::GET && req.req_method != request::OPTIONS) {
+    // Unsafe methods invalidate what is cached for the URL.
+    auto const address = req.address;
+    return pool_->query(
+        std::move(req), [cache = cache_, address, cb = std::move(cb)](
+                            response res, error_code ec) {
+          if (!ec && res.status_code < 400) {
+            cache->invalidate(address);
+          }
+          cb(std::move(res), ec);
+        });
+  }
+
+  auto const cc = cache_control{header(req, "cache-control").value_or("")};
+  if (req.req_method != request::GET || req.response_sink || cc.no_store_ ||
+      header(req, "if-none-match").has_value() ||
+      header(req, "if-modified-since").has_value()) {
+    return pool_->query(std::move(req), std::move(cb));
+  }
+
+  auto const now = std::chrono::steady_clock::now();
+  auto hit = cache_->get(req, now);
+  if (hit.has_value() && hit->fresh_ && !cc.no_cache_) {
+    ++cache_->stats().hits_;
+    return asio::post(pool_->get_executor(),
+                      [cb = std::move(cb), res = std::move(hit->res_)]() {
+                        cb(res, error_code{});
+                      });
+  }
+
+  auto conditional = req;
+  auto const revalidate = hit.has_value() &&
+                          (!hit->etag_.empty() || !hit->last_modified_.empty());
+  if (revalidate && !hit->etag_.empty()) {
+    conditional.headers["If-None-Match"] = hit->etag_;
+  }
+  if (revalidate && !hit->last_modified_.empty()) {
+    conditional.headers["If-Modified-Since"] = hit->last_modified_;
+  }
+
+  auto const r = std::make_shared<request>(std::move(req));
+  pool_->query(std::move(conditional), [self = shared_from_this(), r,
+                                        cb = std::move(cb), revalidate, now](
+                                           response res, error_code ec) {
+    if (!ec && revalidate && res.status_code == 304) {
+      if (auto updated = self->cache_->update(*r, res, now)) {
+        ++self->cache_->stats().revalidated_;
+        return cb(std::move(*updated), ec);
+      }
+      return self->query(std::move(*r), std::move(cb));  // evicted meanwhile
+    }
+
+    ++self->cache_->stats().misses_;
+    if (!ec) {
+      self->cache_->put(*r, res, now);
+    }
+    cb(std::move(res), ec);
+  });
+}
+
+}  // namespace net::http::client
@@ -0,0 +1,223 @@
+#include "net/http/client/request_policy.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+
+namespace net::http::client {
+
+namespace {
+
+constexpr auto const kLatencySamples = std::size_t{128U};
+
+bool is_idempotent(request::method const m) {
+  return m != request::POST && m != request::CONNECT;
+}
+
+bool is_unavailable(int const status) {
+  return status == 502 || status == 503 || status == 504;
+}
+
+}  // namespace
+
+struct policy_client::query_state {
+  struct running {
+    std::shared_ptr<query_handle> handle_;
+    std::chrono::steady_clock::time_point start_;
+    bool done_{false};
+  };
+
+  query_state(asio::io_context::executor_type const& executor, request req,
+              callback cb)
+      : req_(std::move(req)),
+        cb_(std::move(cb)),
+        // A streamed body cannot be taken back: no second attempt.
+        idempotent_(is_idempotent(req_.req_method) && !req_.response_sink),
+        deadline_(executor),
+        hedge_(executor),
+        backoff_(executor) {
+    auto const peer = req_.peer();
+    key_ = peer.host() + ':' + peer.port();
+  }
+
+  request req_;
+  callback cb_;
+  std::string key_;
+  bool idempotent_;
+  asio::steady_timer deadline_, hedge_, backoff_;
+  std::vector<running> attempts_;
+  unsigned in_flight_{0U}, retries_{0U};
+  bool done_{false};
+};
+
+policy_client::policy_client(std::shared_ptr<connection_pool> pool,
+                             request_policy policy)
+    : pool_(std::move(pool)), policy_(std::move(policy)) {}
+
+void policy_client::query(request req, callback cb) {
+  auto const q = std::make_shared<query_state>(pool_->get_executor(),
+                                               std::move(req), std::move(cb));
+  ++stats_.queries_;
+
+  if (policy_.deadline_.count() != 0) {
+    q->deadline_.expires_after(policy_.deadline_);
+    q->deadline_.async_wait(
+        [self = shared_from_this(), q](error_code const& ec) {
+          if (!ec && !q->done_) {
+            ++self->stats_.deadlines_exceeded_;
+            self->finish(q, {0, {}, ""}, asio::error::timed_out);
+          }
+        });
+  }
+
+  attempt(q, false);
+}
+
+void policy_client::attempt(std::shared_ptr<query_state> const& q,
+                            bool const hedge) {
+  auto const i = q->attempts_.size();
+  auto const handle = std::make_shared<query_handle>();
+  q->attempts_.push_back({handle, std::chrono::steady_clock::now()});
+  ++q->in_flight_;
+
+  pool_->query(
+      q->req_,
+      [self = shared_from_this(), q, i, hedge](response res, error_code ec) {
+        self->on_attempt(q, i, hedge, std::move(res), ec);
+      },
+      handle);
+
+  auto delay = std::chrono::microseconds{};
+  if (hedge || !policy_.hedge_ || !q->idempotent_ || q->done_ ||
+      q->attempts_.size() >= policy_.max_attempts_ ||
+      !hedge_delay(q->key_, delay)) {
+    return;
+  }
+  q->hedge_.expires_after(delay);
+  q->hedge_.async_wait(
+      [self = shared_from_this(), q, i](error_code const& ec) {
+        // Hedge only a still running attempt that is the only one.
+        if (ec || q->done_ || q->attempts_[i].done_ || q->in_flight_ != 1U ||
+            q->attempts_.size() >= self->policy_.max_attempts_) {
+          return;
+        }
+        ++self->stats_.hedges_fired_;
+        self->attempt(q, true);
+      });
+}
+
+void policy_client::on_attempt(std::shared_ptr<query_state> const& q,
+                               std::size_t const i, bool const hedge,
+                               response res, error_code ec) {
+  auto& a = q->attempts_[i];
+  a.done_ = true;
+  --q->in_flight_;
+  if (q->done_) {
+    return;
+  }
+
+  auto const now = std::chrono::steady_clock::now();
+  auto const retry_status =
+      !ec && policy_.retry_unavailable_ && is_unavailable(res.status_code);
+  if (!ec && !retry_status) {
+    record_latency(q->key_,
+                   std::chrono::duration_cast<std::chrono::microseconds>(
+                       now - a.start_));
+    if (hedge) {
+      ++stats_.hedges_won_;
+    }
+    return finish(q, std::move(res), ec);
+  }
+
+  if (q->in_flight_ != 0U) {
+    return;  // the other attempt may still succeed
+  }
+
+  if (!q->idempotent_ || q->attempts_.size() >= policy_.max_attempts_) {
+    return finish(q, std::move(res), ec);
+  }
+
+  auto const delay = backoff(++q->retries_);
+  if (policy_.deadline_.count() != 0 &&
+      now + delay >= q->deadline_.expiry()) {
+    return finish(q, std::move(res), ec);  // no time left for another try
+  }
+
+  ++stats_.retries_;
+  q->backoff_.expires_after(delay);
+  q->backoff_.async_wait([self = shared_from_this(), q](error_code const& ec) {
+    if (!ec && !q->done_) {
+      self->attempt(q, false);
+    }
+  });
+}
+
+void policy_client::finish(std::shared_ptr<query_state> const& q,
+                           response res, error_code ec) {
+  q->done_ = true;
+  q->deadline_.cancel();
+  q->hedge_.cancel();
+  q->backoff_.cancel();
+  for (auto i = std::size_t{0U}; i != q->attempts_.size(); ++i) {
+    if (!q->attempts_[i].done_) {
+      q->attempts_[i].handle_->cancel();
+    }
+  }
+  q->cb_(std::move(res), ec);
+}
+
+std::chrono::milliseconds policy_client::backoff(unsigned const retry) {
+  auto delay = policy_.backoff_;
+  for (auto r = 1U; r < retry && delay < policy_.max_backoff_; ++r) {
+    delay *= 2;
+  }
+  delay = std::min(delay, policy_.max_backoff_);
+
+  std::lock_guard<std::mutex> const lock{mutex_};
+  return std::chrono::milliseconds{
+      std::uniform_int_distribution<std::chrono::milliseconds::rep>{
+          delay.count() / 2, delay.count()}(rng_)};
+}
+
+void policy_client::record_latency(std::string const& key,
+                                   std::chrono::microseconds const latency) {
+  std::lock_guard<std::mutex> const lock{mutex_};
+  auto& l = latencies_[key];
+  auto const us = static_cast<std::uint32_t>(
+      std::min<std::chrono::microseconds::rep>(
+          latency.count(), std::numeric_limits<std::uint32_t>::max()));
+  if (l.us_.size() < kLatencySamples) {
+    l.us_.push_back(us);
+  } else {
+    l.us_[l.next_] = us;
+    l.next_ = (l.next_ + 1U) % kLatencySamples;
+  }
+}
+
+bool policy_client::hedge_delay(std::string const& key,
+                                std::chrono::microseconds& delay) {
+  auto samples = std::vector<std::uint32_t>{};
+  {
+    std::lock_guard<std::mutex> const lock{mutex_};
+    auto const it = latencies_.find(key);
+    if (it == end(latencies_) || it->second.us_.empty() ||
+        it->second.us_.size() < policy_.min_samples_) {
+      return false;
+    }
+    samples = it->second.us_;
+  }
+
+  auto const n = std::min(
+      samples.size() - 1U,
+      static_cast<std::size_t>(policy_.hedge_percentile_ *
+                               static_cast<double>(samples.size() - 1U)));
+  std::nth_element(begin(samples), begin(samples) + n, end(samples));
+  delay = std::max(std::chrono::microseconds{samples[n]},
+                   std::chrono::microseconds{policy_.min_hedge_delay_});
+  return true;
+}
+
+}  // namespace net::http::client
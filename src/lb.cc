@@ -1,23 +1,31 @@
 #include "net/lb.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <cstdint>
+#include <deque>
 #include <iostream>
+#include <iterator>
 #include <memory>
+#include <optional>
 #include <queue>
+#include <random>
 #include <string>
 #include <thread>
 #include <unordered_map>
 #include <vector>
 
 #if defined(__linux__)
+#include <sys/resource.h>
 #include <unistd.h>
 #endif
 
 #include "boost/asio/co_spawn.hpp"
 #include "boost/asio/connect.hpp"
 #include "boost/asio/detached.hpp"
+#include "boost/asio/dispatch.hpp"
 #include "boost/asio/ip/tcp.hpp"
 #include "boost/asio/redirect_error.hpp"
 #include "boost/asio/ssl.hpp"
@@ -38,6 +46,8 @@
 #include "utl/visit.h"
 
 #include "net/base64.h"
+#include "net/lb_protocol.h"
+#include "net/mpsc_queue.h"
 
 using tcp = boost::asio::ip::tcp;
 namespace websocket = boost::beast::websocket;
@@ -49,7 +59,68 @@ using namespace boost::asio;
 namespace net {
 using load_avg_t = unsigned;
 
-using queue_entry_t = std::variant<load_avg_t, web_server::http_res_t>;
+struct tunnel_response {
+  std::uint32_t id_;
+  web_server::http_res_t res_;
+};
+
+// Stream abandoned without response (deadline passed).
+struct stream_cancel {
+  std::uint32_t id_;
+};
+
+using queue_entry_t =
+    std::variant<load_avg_t, load_report, tunnel_response, stream_cancel>;
+
+// Shared by all tunnel connections of one lb.
+struct lb_stats {
+  void add_latency(std::chrono::steady_clock::duration const d) {
+    // EWMA with alpha = 1/8.
+    auto const sample = static_cast<std::int64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    auto prev = latency_us_.load();
+    auto next = std::int64_t{};
+    do {
+      next = prev == 0 ? sample : prev + (sample - prev) / 8;
+    } while (!latency_us_.compare_exchange_weak(prev, next));
+  }
+
+  std::atomic_uint32_t in_flight_{0U};
+  std::atomic_int64_t latency_us_{0};
+};
+
+struct cpu_sampler {
+  // Process CPU time since the last call, in permille of all cores.
+  std::uint16_t sample() {
+#if defined(__linux__)
+    auto usage = rusage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+      return 0U;
+    }
+    auto const to_us = [](timeval const& t) {
+      return std::chrono::microseconds{t.tv_sec * 1'000'000LL + t.tv_usec};
+    };
+    auto const cpu = to_us(usage.ru_utime) + to_us(usage.ru_stime);
+    auto const now = std::chrono::steady_clock::now();
+    auto const wall =
+        std::chrono::duration_cast<std::chrono::microseconds>(now - last_wall_);
+    auto const cores = std::max(1U, std::thread::hardware_concurrency());
+    auto const permille =
+        wall.count() == 0 || last_cpu_.count() == 0
+            ? 0
+            : (cpu - last_cpu_).count() * 1000 / (wall.count() * cores);
+    last_cpu_ = cpu;
+    last_wall_ = now;
+    return static_cast<std::uint16_t>(
+        std::clamp<std::int64_t>(permille, 0, 1000));
+#else
+    return 0U;
+#endif
+  }
+
+  std::chrono::microseconds last_cpu_{0};
+  std::chrono::steady_clock::time_point last_wall_{};
+};
 
 std::optional<web_server::http_req_t> parse_request(
     std::string_view raw, boost::beast::error_code& ec) {
@@ -103,33 +174,90 @@ std::string to_str(web_server::http_res_t& x) {
 
 std::string to_str(load_avg_t const x) { return fmt::to_string(x); }
 
+std::string to_str(tunnel_response& x) {
+  std::visit([&](auto& res) { res.set("x-request-id", fmt::to_string(x.id_)); },
+             x.res_);
+  return to_str(x.res_);
+}
+
 using wss_stream = websocket::stream<ssl::stream<tcp::socket>>;
 using ws_stream = websocket::stream<tcp::socket>;
 
+// Shared-owned: the coroutines and response callbacks hold a reference, so
+// a connection lives until all of them have finished.
 template <typename Stream>
-struct conn : public lb::impl {
-  conn(io_context& ioc, std::string const& url, web_server::http_req_cb_t cb)
+struct conn : public lb::impl,
+              public std::enable_shared_from_this<conn<Stream>> {
+  conn(io_context& ioc,
+       std::string const& url,
+       lb::http_req_cb_t cb,
+       lb_settings const& settings,
+       std::shared_ptr<lb_stats> stats,
+       unsigned const idx)
       : ioc_{ioc},
+        idx_{idx},
         url_{url},
         http_callback_{std::move(cb)},
+        settings_{settings},
+        stats_{std::move(stats)},
         ssl_ctx_{ssl::context::tls_client} {}
 
-  ~conn() override { stop(); }
-
+  // All connection state (stream, queues, request maps) is confined to
+  // strand_. Responses from other threads enter through submit().
   void run() override {
-    co_spawn(ioc_, loop(), detached);
-    co_spawn(ioc_, loadavg_timer_loop(), detached);
+    spawn(&conn::loop);
+    spawn(&conn::load_report_loop);
   }
 
+  // The read loop ends once the stream is closed. Before the WebSocket
+  // handshake completed, the socket is closed directly.
   void stop() override {
-    if (ws_) {
-      boost::system::error_code ec;
-      ws_->close(websocket::close_code::normal, ec);
+    stopped_ = true;
+    boost::asio::dispatch(strand_, [self = this->shared_from_this()]() {
+      self->reconnect_timer_.cancel();
+      self->load_timer_.cancel();
+      if (!self->ws_) {
+        return;
+      }
+      if (self->ws_->is_open()) {
+        self->ws_->async_close(websocket::close_code::normal,
+                               [self](boost::system::error_code) {});
+      } else {
+        auto ec = boost::system::error_code{};
+        boost::beast::get_lowest_layer(*self->ws_).close(ec);
+      }
+    });
+  }
+
+  // Runs a member coroutine on strand_, keeping the connection alive.
+  template <typename... Args>
+  void spawn(awaitable<void> (conn::*fn)(Args...), Args... args) {
+    co_spawn(
+        strand_,
+        [self = this->shared_from_this(), fn, args...]() mutable {
+          return ((*self).*fn)(std::move(args)...);
+        },
+        detached);
+  }
+
+  void set_state(lb_state const s) const {
+    if (settings_.on_state_change_) {
+      settings_.on_state_change_(idx_, s);
     }
   }
 
+  std::chrono::milliseconds next_reconnect_delay() {
+    auto const delay =
+        std::min(settings_.reconnect_max_,
+                 settings_.reconnect_min_ * (1U << std::min(failures_, 16U)));
+    ++failures_;
+    return std::chrono::milliseconds{std::uniform_int_distribution{
+        delay.count() / 2, delay.count()}(rng_)};
+  }
+
   awaitable<void> loop() {
-    while (true) {
+    while (!stopped_) {
+      set_state(lb_state::kConnecting);
       try {
         ssl_ctx_ = ssl::context{ssl::context::tls_client};
         ssl_ctx_.set_default_verify_paths();
@@ -141,11 +269,32 @@ struct conn : public lb::impl {
       } catch (std::exception const& e) {
         std::cout << "web socket lb error: " << e.what() << std::endl;
       }
-      fmt::println("websocket {} disconnected, reconnecting in 1s", url_);
-      std::this_thread::sleep_for(std::chrono::seconds{1});
+      if (connected_at_.has_value() &&
+          std::chrono::steady_clock::now() - *connected_at_ >=
+              settings_.reconnect_stable_) {
+        failures_ = 0U;
+      }
+      connected_at_.reset();
       ws_.reset();
+      binary_ = false;
+      partial_requests_.clear();
+      streams_.clear();
+      cancel_all();
       write_in_progress_ = false;
       write_queue_ = {};
+      set_state(lb_state::kDisconnected);
+
+      if (stopped_) {
+        break;
+      }
+
+      // Wait asynchronously: other tunnel connections share the io_context.
+      auto const delay = next_reconnect_delay();
+      fmt::println("websocket {} disconnected, reconnecting in {}ms", url_,
+                   delay.count());
+      reconnect_timer_.expires_after(delay);
+      auto ec = boost::system::error_code{};
+      co_await reconnect_timer_.async_wait(redirect_error(use_awaitable, ec));
     }
   }
 
@@ -200,18 +349,35 @@ struct conn : public lb::impl {
           websocket::stream_base::decorator([&](websocket::request_type& req) {
             req.set(http::field::user_agent, "MOTIS lb/1.0");
             req.set(http::field::host, host);
+            req.set(http::field::sec_websocket_protocol,
+                    boost::beast::string_view{kLbProtocol.data(),
+                                              kLbProtocol.size()});
           }));
 
       // Websocket handshake (upgrade request).
+      // Binary framing if the balancer accepts the subprotocol,
+      // HTTP/1.1 text messages otherwise.
       auto host_port = host + ':' + std::to_string(ep.port());
-      co_await ws_->async_handshake(host_port, path, use_awaitable);
+      auto res = websocket::response_type{};
+      co_await ws_->async_handshake(res, host_port, path, use_awaitable);
+      binary_ = res[http::field::sec_websocket_protocol] ==
+                boost::beast::string_view{kLbProtocol.data(),
+                                          kLbProtocol.size()};
+
+      connected_at_ = std::chrono::steady_clock::now();
+      set_state(lb_state::kConnected);
 
       std::cout << "LB " << host_port << ", awaiting requests." << std::endl;
       while (true) {
         auto buffer = boost::beast::multi_buffer{};
         co_await ws_->async_read(buffer, use_awaitable);
+        failures_ = 0U;  // the balancer is talking to us
         auto message = boost::beast::buffers_to_string(buffer.data());
-        co_spawn(executor, process_http_request(std::move(message)), detached);
+        if (binary_) {
+          process_frame(message);
+        } else {
+          spawn(&conn::process_http_request, std::move(message));
+        }
       }
     } catch (std::exception const& e) {
       fmt::println(
@@ -220,49 +386,123 @@ struct conn : public lb::impl {
     }
   }
 
-  awaitable<void> loadavg_timer_loop() {
+  static load_avg_t load_avg() {
 #if defined(__linux__)
-    auto executor = co_await this_coro::executor;
-    auto timer = steady_timer{executor};
-    while (true) {
-      double loads[3];
-      if (getloadavg(loads, 1) == 1) {
-        auto const cores = std::thread::hardware_concurrency();
-        auto const pct = (loads[0] / static_cast<double>(cores)) * 100;
-        queue_write(static_cast<load_avg_t>(std::lround(pct)));
-      } else {
-        std::cerr << "UNABLE TO GET loadavg\n";
+    double loads[3];
+    if (getloadavg(loads, 1) == 1) {
+      auto const cores = std::thread::hardware_concurrency();
+      auto const pct = (loads[0] / static_cast<double>(cores)) * 100;
+      return static_cast<load_avg_t>(std::lround(pct));
+    }
+    std::cerr << "UNABLE TO GET loadavg\n";
+#endif
+    return 0U;
+  }
+
+  awaitable<void> load_report_loop() {
+    auto cpu = cpu_sampler{};
+    auto last_load_avg = std::chrono::steady_clock::time_point{};
+    auto load_avg_pct = load_avg_t{0U};
+    while (!stopped_) {
+      expire_requests();
+
+      // getloadavg is a one minute average: no need to sample it faster.
+      auto const now = std::chrono::steady_clock::now();
+      if (now - last_load_avg >= std::chrono::seconds{5}) {
+        load_avg_pct = load_avg();
+        last_load_avg = now;
+      }
+
+      if (binary_) {
+        auto const queue_depth =
+            settings_.queue_depth_ ? settings_.queue_depth_() : 0U;
+        queue_write(load_report{
+            .in_flight_ = stats_->in_flight_.load(),
+            .queue_depth_ = static_cast<std::uint32_t>(queue_depth),
+            .latency_us_ = static_cast<std::uint32_t>(stats_->latency_us_),
+            .cpu_permille_ = cpu.sample(),
+            .load_avg_pct_ = static_cast<std::uint16_t>(
+                std::min(load_avg_pct, load_avg_t{0xFFFFU}))});
+      } else if (ws_ && now == last_load_avg) {
+        queue_write(load_avg_pct);
       }
 
-      timer.expires_after(std::chrono::seconds{5});
+      load_timer_.expires_after(settings_.load_interval_);
       auto ec = boost::system::error_code{};
-      co_await timer.async_wait(redirect_error(use_awaitable, ec));
+      co_await load_timer_.async_wait(redirect_error(use_awaitable, ec));
       if (ec == error::operation_aborted) {
         co_return;
       }
     }
-#else
-    std::cerr << "WARNING: LOAD AVG TIMER ONLY IMPLEMENTED FOR LINUX\n";
-    co_return;
-#endif
+  }
+
+  // Returns the next message to write. Binary mode: responses are split
+  // into frames and the streams take turns, one frame each.
+  std::optional<std::string> next_message() {
+    while (!write_queue_.empty()) {
+      auto msg = std::move(write_queue_.front());
+      write_queue_.pop();
+
+      if (binary_ && std::holds_alternative<tunnel_response>(msg)) {
+        auto& x = std::get<tunnel_response>(msg);
+        try {
+          streams_.emplace_back(x.id_, std::move(x.res_),
+                                settings_.max_chunk_size_);
+        } catch (std::exception const& e) {
+          std::cerr << "Error preparing response for ID " << x.id_ << ": "
+                    << e.what() << std::endl;
+          return encode_cancel(x.id_);
+        }
+        continue;
+      }
+
+      ws_->binary(!std::holds_alternative<load_avg_t>(msg));
+      return std::visit(
+          utl::overloaded{[](load_avg_t const x) { return to_str(x); },
+                          [](load_report const& x) { return encode_load(x); },
+                          [](tunnel_response& x) { return to_str(x); },
+                          [](stream_cancel const& x) {
+                            return encode_cancel(x.id_);
+                          }},
+          msg);
+    }
+
+    if (streams_.empty()) {
+      return std::nullopt;
+    }
+
+    auto s = std::move(streams_.front());
+    streams_.pop_front();
+    ws_->binary(true);
+    try {
+      auto frame = s.next();
+      if (!s.done()) {
+        streams_.emplace_back(std::move(s));
+      }
+      return frame;
+    } catch (std::exception const& e) {
+      std::cerr << "Error streaming response for ID " << s.stream_id() << ": "
+                << e.what() << std::endl;
+      return encode_cancel(s.stream_id());
+    }
   }
 
   awaitable<void> process_write_queue() {
-    if (write_in_progress_ || write_queue_.empty() || !ws_) {
+    if (write_in_progress_ || !ws_) {
       co_return;
     }
 
     write_in_progress_ = true;
 
-    while (!write_queue_.empty() && ws_) {
-      auto& msg = write_queue_.front();
-      auto const message = std::visit([](auto& x) { return to_str(x); }, msg);
-      ws_->binary(std::holds_alternative<web_server::http_res_t>(msg));
-      write_queue_.pop();
+    while (ws_) {
+      auto const message = next_message();
+      if (!message.has_value()) {
+        break;
+      }
 
       try {
         auto const bytes_written =
-            co_await ws_->async_write(buffer(message), use_awaitable);
+            co_await ws_->async_write(buffer(*message), use_awaitable);
       } catch (std::exception const& e) {
         std::cerr << "Error in write: " << e.what() << std::endl;
         break;
@@ -272,10 +512,39 @@ struct conn : public lb::impl {
     write_in_progress_ = false;
   }
 
+  // Strand only.
   void queue_write(queue_entry_t message) {
     write_queue_.push(std::move(message));
     if (!write_in_progress_) {
-      co_spawn(ioc_, process_write_queue(), detached);
+      spawn(&conn::process_write_queue);
+    }
+  }
+
+  // Thread-safe: called by response callbacks from any thread.
+  void submit(tunnel_response&& res) {
+    inbox_.push(std::move(res));
+    if (!drain_scheduled_.exchange(true)) {
+      boost::asio::dispatch(strand_, [self = this->shared_from_this()]() {
+        self->drain_inbox();
+      });
+    }
+  }
+
+  void drain_inbox() {
+    // Reset before draining: a producer that observes `false` afterwards
+    // schedules another drain, so no response is left behind.
+    drain_scheduled_ = false;
+    while (auto res = inbox_.pop()) {
+      auto const it = active_.find(res->id_);
+      if (it == end(active_)) {
+        continue;  // cancelled or connection lost
+      }
+      if (it->second.cancelled()) {
+        abandon(it);
+      } else {
+        active_.erase(it);
+        queue_write(std::move(*res));
+      }
     }
   }
 
@@ -291,21 +560,8 @@ struct conn : public lb::impl {
       auto const id =
           utl::parse_verify<unsigned>({id_str.data(), id_str.size()});
 
-      // Call the HTTP request handler
-      http_callback_(
-          std::move(*req),
-          [this, id](web_server::http_res_t&& response) {
-            std::visit(
-                [&](auto& res) { res.set("x-request-id", fmt::to_string(id)); },
-                response);
-            try {
-              queue_write(std::move(response));
-            } catch (std::exception const& e) {
-              std::cerr << "Error preparing response for ID " << id << ": "
-                        << e.what() << std::endl;
-            }
-          },
-          false);
+      dispatch(id, std::move(*req),
+               register_request(id, std::chrono::milliseconds{0}));
     } catch (std::out_of_range) {
       std::cerr << "Request without x-request-id header" << std::endl;
     } catch (std::exception const& e) {
@@ -314,24 +570,210 @@ struct conn : public lb::impl {
     co_return;
   }
 
+  void process_frame(std::string const& msg) {
+    try {
+      auto const f = decode_frame(msg);
+      switch (f.type_) {
+        case frame_type::kRequest: {
+          auto [timeout, req] = decode_request(f.payload_);
+          auto token = register_request(f.stream_id_, timeout);
+          if ((f.flags_ & kEndStream) != 0U) {
+            dispatch(f.stream_id_, std::move(req), std::move(token));
+          } else {
+            partial_requests_[f.stream_id_] = {std::move(req),
+                                               std::move(token)};
+          }
+          break;
+        }
+
+        case frame_type::kData: {
+          auto const it = partial_requests_.find(f.stream_id_);
+          if (it == end(partial_requests_)) {
+            break;  // cancelled while the body was still being sent
+          }
+          it->second.first.body().append(f.payload_);
+          if ((f.flags_ & kEndStream) != 0U) {
+            auto [req, token] = std::move(it->second);
+            partial_requests_.erase(it);
+            dispatch(f.stream_id_, std::move(req), std::move(token));
+          }
+          break;
+        }
+
+        case frame_type::kCancel: {
+          partial_requests_.erase(f.stream_id_);
+          std::erase_if(streams_, [&](response_encoder const& s) {
+            return s.stream_id() == f.stream_id_;
+          });
+          if (auto const it = active_.find(f.stream_id_); it != end(active_)) {
+            *it->second.cancelled_ = true;
+            active_.erase(it);
+          }
+          break;
+        }
+
+        default:
+          std::cerr << "Unexpected lb frame type "
+                    << static_cast<unsigned>(f.type_) << std::endl;
+      }
+    } catch (std::exception const& e) {
+      std::cerr << "Error processing lb frame: " << e.what() << std::endl;
+    }
+  }
+
+  cancel_token register_request(std::uint32_t const id,
+                                std::chrono::milliseconds const timeout) {
+    auto token = cancel_token{.cancelled_ = std::make_shared<std::atomic_bool>(
+                                  false)};
+    if (timeout.count() != 0) {
+      token.deadline_ = std::chrono::steady_clock::now() + timeout;
+    }
+    active_[id] = token;
+    return token;
+  }
+
+  // Still in active_ but cancelled: the deadline has passed (a CANCEL from
+  // the balancer removes the entry). The balancer is told that the stream
+  // ends without a response.
+  void abandon(std::unordered_map<std::uint32_t, cancel_token>::iterator it) {
+    auto const id = it->first;
+    active_.erase(it);
+    if (binary_) {
+      queue_write(stream_cancel{id});
+    }
+  }
+
+  // A handler may never answer: requests past their deadline are dropped
+  // here (once per load report interval) instead of when the response
+  // arrives.
+  void expire_requests() {
+    for (auto it = begin(active_); it != end(active_);) {
+      auto const next = std::next(it);
+      if (it->second.cancelled()) {
+        partial_requests_.erase(it->first);
+        abandon(it);
+      }
+      it = next;
+    }
+  }
+
+  // Responses can't be delivered after a disconnect: cancel everything.
+  void cancel_all() {
+    for (auto& [id, token] : active_) {
+      *token.cancelled_ = true;
+    }
+    active_.clear();
+  }
+
+  void dispatch(std::uint32_t const id,
+                web_server::http_req_t req,
+                cancel_token token) {
+    if (token.cancelled()) {
+      if (auto const it = active_.find(id); it != end(active_)) {
+        abandon(it);
+      }
+      return;
+    }
+
+    ++stats_->in_flight_;
+
+    // Call the HTTP request handler
+    http_callback_(
+        std::move(req),
+        [self = this->shared_from_this(), id,
+         start = std::chrono::steady_clock::now()](
+            web_server::http_res_t&& response) {
+          --self->stats_->in_flight_;
+          self->stats_->add_latency(std::chrono::steady_clock::now() - start);
+          self->submit(tunnel_response{id, std::move(response)});
+        },
+        false, std::move(token));
+  }
+
   io_context& ioc_;
-  strand<io_context::executor_type> write_strand_{make_strand(ioc_)};
+  unsigned idx_;
+  strand<io_context::executor_type> strand_{make_strand(ioc_)};
+  steady_timer reconnect_timer_{strand_};
+  steady_timer load_timer_{strand_};
+  unsigned failures_{0U};
+  std::optional<std::chrono::steady_clock::time_point> connected_at_;
+  std::minstd_rand rng_{std::random_device{}()};
+  std::atomic_bool stopped_{false};
   std::queue<queue_entry_t> write_queue_;
   bool write_in_progress_{false};
+  mpsc_queue<tunnel_response> inbox_;
+  std::atomic_bool drain_scheduled_{false};
   std::string url_;
-  web_server::http_req_cb_t http_callback_;
+  lb::http_req_cb_t http_callback_;
+  lb_settings settings_;  // copy: may outlive the conn_pool
+  std::shared_ptr<lb_stats> stats_;
   ssl::context ssl_ctx_;
   std::unique_ptr<Stream> ws_;
+  bool binary_{false};
+  std::unordered_map<std::uint32_t,
+                     std::pair<web_server::http_req_t, cancel_token>>
+      partial_requests_;
+  std::deque<response_encoder> streams_;
+  std::unordered_map<std::uint32_t, cancel_token> active_;
+};
+
+struct conn_pool : public lb::impl {
+  conn_pool(io_context& ioc,
+            std::string const& url,
+            lb::http_req_cb_t const& cb,
+            lb_settings settings)
+      : settings_{std::move(settings)} {
+    auto const stats = std::make_shared<lb_stats>();
+    conns_.reserve(settings_.connections_);
+    for (auto i = 0U; i != settings_.connections_; ++i) {
+      conns_.emplace_back(
+          url.starts_with("wss://")
+              ? std::shared_ptr<lb::impl>{std::make_shared<conn<wss_stream>>(
+                    ioc, url, cb, settings_, stats, i)}
+              : std::shared_ptr<lb::impl>{std::make_shared<conn<ws_stream>>(
+                    ioc, url, cb, settings_, stats, i)});
+    }
+  }
+
+  // The connections finish their coroutines on the io_context and are
+  // freed by the last of them.
+  ~conn_pool() override { stop(); }
+
+  void run() override {
+    for (auto& c : conns_) {
+      c->run();
+    }
+  }
+
+  void stop() override {
+    for (auto& c : conns_) {
+      c->stop();
+    }
+  }
+
+  lb_settings settings_;
+  std::vector<std::shared_ptr<lb::impl>> conns_;
 };
 
 lb::impl::~impl() = default;
 
-lb::lb(io_context& ios, std::string const& url, web_server::http_req_cb_t cb)
-    : impl_(url.starts_with("wss://")
-                ? static_cast<impl*>(new conn<wss_stream>{ios, url, cb})
-                : static_cast<impl*>(new conn<ws_stream>{ios, url, cb})) {
+lb::lb(io_context& ios, std::string const& url, web_server::http_req_cb_t cb,
+       lb_settings const& settings)
+    : lb{ios, url,
+         [cb = std::move(cb)](web_server::http_req_t req,
+                              web_server::http_res_cb_t res_cb, bool is_ssl,
+                              cancel_token) {
+           cb(std::move(req), std::move(res_cb), is_ssl);
+         },
+         settings} {}
+
+lb::lb(io_context& ios, std::string const& url, http_req_cb_t cb,
+       lb_settings const& settings) {
   utl::verify(url.starts_with("wss://") || url.starts_with("ws://"),
               "invalid lbs url: {:?}", url);
+  utl::verify(settings.connections_ != 0U, "lb: no tunnel connections");
+  utl::verify(settings.max_chunk_size_ != 0U, "lb: max_chunk_size_ is 0");
+  impl_ = std::make_unique<conn_pool>(ios, url, cb, settings);
 }
 
 lb::~lb() = default;
@@ -0,0 +1,412 @@
+#include "net/lb_hub.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "boost/asio/post.hpp"
+#include "boost/asio/steady_timer.hpp"
+#include "boost/asio/strand.hpp"
+#include "boost/beast/http.hpp"
+
+#include "net/lb_protocol.h"
+#include "net/web_server/responses.h"
+#include "net/web_server/websocket_session.h"
+
+namespace http = boost::beast::http;
+
+namespace net {
+
+namespace {
+
+std::string_view path_of(std::string_view target) {
+  return target.substr(0U, target.find('?'));
+}
+
+bool is_idempotent(http::verb const v) {
+  switch (v) {
+    case http::verb::get:
+    case http::verb::head:
+    case http::verb::put:
+    case http::verb::delete_:
+    case http::verb::options:
+    case http::verb::trace: return true;
+    default: return false;
+  }
+}
+
+}  // namespace
+
+struct lb_hub::impl : public std::enable_shared_from_this<lb_hub::impl> {
+  struct pending_request {
+    std::shared_ptr<web_server::http_req_t const> req_;
+    web_server::http_res_cb_t cb_;
+    unsigned attempts_{0U};
+    std::optional<web_server::string_res_t> res_;
+    std::optional<std::chrono::steady_clock::time_point> deadline_;
+    bool sent_{false};  // the worker may have seen the request
+    std::shared_ptr<boost::asio::steady_timer> timer_;  // on strand_
+  };
+
+  struct worker {
+    // Lower is better.
+    std::uint64_t score() const {
+      return std::max(outstanding_.load(), reported_in_flight_.load()) +
+             reported_queue_depth_.load();
+    }
+
+    ws_session_ptr session_;
+    std::atomic_uint32_t outstanding_{0U};
+    std::atomic_uint32_t reported_in_flight_{0U};
+    std::atomic_uint32_t reported_queue_depth_{0U};
+
+    std::mutex mutex_;
+    bool closed_{false};
+    std::unordered_map<std::uint32_t, pending_request> pending_;
+  };
+
+  using worker_ptr = std::shared_ptr<worker>;
+
+  impl(boost::asio::io_context& ioc, lb_hub_settings settings)
+      : settings_{std::move(settings)},
+        strand_{boost::asio::make_strand(ioc)} {}
+
+  bool is_tunnel(std::string_view target) const {
+    return path_of(target) == settings_.path_;
+  }
+
+  bool upgrade_ok(web_server::http_req_t const& req) const {
+    if (!is_tunnel({req.target().data(), req.target().size()})) {
+      return true;
+    }
+    return !select_subprotocol(req, {std::string{kLbProtocol}}).empty();
+  }
+
+  bool open(ws_session_ptr const& session, std::string const& target) {
+    auto const s = session.lock();
+    if (s == nullptr || !is_tunnel(target)) {
+      return false;
+    }
+
+    auto w = std::make_shared<worker>();
+    w->session_ = session;
+
+    auto const weak_self = weak_from_this();
+    auto const weak_w = std::weak_ptr<worker>{w};
+    s->on_msg([weak_self, weak_w](std::string const& msg,
+                                  ws_msg_type const type) {
+      auto const self = weak_self.lock();
+      auto const w = weak_w.lock();
+      if (self != nullptr && w != nullptr && type == ws_msg_type::BINARY) {
+        self->on_frame(w, msg);
+      }
+    });
+    s->on_close([weak_self, w]() {
+      if (auto const self = weak_self.lock()) {
+        self->remove(w);
+      }
+    });
+
+    auto const lock = std::lock_guard{mutex_};
+    workers_.emplace_back(std::move(w));
+    return true;
+  }
+
+  void remove(worker_ptr const& w) {
+    {
+      auto const lock = std::lock_guard{mutex_};
+      std::erase(workers_, w);
+    }
+
+    auto pending = std::unordered_map<std::uint32_t, pending_request>{};
+    {
+      auto const lock = std::lock_guard{w->mutex_};
+      w->closed_ = true;
+      pending = std::exchange(w->pending_, {});
+    }
+    for (auto& [id, p] : pending) {
+      retry(std::move(p));
+    }
+  }
+
+  // Power of two choices: the less loaded one of two random workers.
+  worker_ptr pick() {
+    auto const lock = std::lock_guard{mutex_};
+    if (workers_.empty()) {
+      return nullptr;
+    }
+    if (workers_.size() == 1U) {
+      return workers_.front();
+    }
+    auto dist = std::uniform_int_distribution<std::size_t>{
+        0U, workers_.size() - 1U};
+    auto const a = dist(rng_);
+    auto b = dist(rng_);
+    while (b == a) {
+      b = dist(rng_);
+    }
+    return workers_[a]->score() <= workers_[b]->score() ? workers_[a]
+                                                        : workers_[b];
+  }
+
+  void dispatch(pending_request&& p) {
+    ++p.attempts_;
+    p.sent_ = false;
+    if (settings_.request_timeout_.count() != 0 && !p.deadline_.has_value()) {
+      p.deadline_ =
+          std::chrono::steady_clock::now() + settings_.request_timeout_;
+    }
+
+    auto const w = pick();
+    auto const session = w == nullptr ? nullptr : w->session_.lock();
+    if (session == nullptr) {
+      auto const& req = *p.req_;
+      p.cb_(string_response(req, "No worker available",
+                            http::status::service_unavailable, "text/plain"));
+      return;
+    }
+
+    auto const id = next_id_++;
+    auto const remaining =
+        p.deadline_.has_value()
+            ? std::max(std::chrono::duration_cast<std::chrono::milliseconds>(
+                           *p.deadline_ - std::chrono::steady_clock::now()),
+                       std::chrono::milliseconds{1})
+            : std::chrono::milliseconds{0};
+    auto frame = encode_request(id, *p.req_, remaining);
+    if (p.deadline_.has_value()) {
+      p.timer_ = std::make_shared<boost::asio::steady_timer>(strand_);
+    }
+    auto const timer = p.timer_;
+    auto const deadline = p.deadline_;
+    auto closed = false;
+    {
+      auto const lock = std::lock_guard{w->mutex_};
+      closed = w->closed_;
+      if (!closed) {
+        w->pending_.emplace(id, std::move(p));
+        ++w->outstanding_;
+      }
+    }
+    if (closed) {
+      return retry(std::move(p));
+    }
+
+    if (timer != nullptr) {
+      boost::asio::post(strand_, [weak_self = weak_from_this(), w, id, timer,
+                                  deadline]() {
+        timer->expires_at(*deadline);
+        timer->async_wait([weak_self, w, id](boost::system::error_code ec) {
+          if (auto const self = weak_self.lock(); !ec && self != nullptr) {
+            self->time_out(w, id);
+          }
+        });
+      });
+    }
+
+    session->send(std::move(frame), ws_msg_type::BINARY,
+                  [weak_self = weak_from_this(), w, id](
+                      boost::system::error_code const ec, std::size_t) {
+                    if (auto const self = weak_self.lock()) {
+                      if (ec) {
+                        self->fail(w, id, false);
+                      } else {
+                        self->mark_sent(*w, id);
+                      }
+                    }
+                  });
+  }
+
+  void retry(pending_request&& p) {
+    cancel_timer(p);
+    if (p.deadline_.has_value() &&
+        std::chrono::steady_clock::now() >= *p.deadline_) {
+      auto const& req = *p.req_;
+      p.cb_(string_response(req, "Worker timed out",
+                            http::status::gateway_timeout, "text/plain"));
+    } else if (p.sent_ && !is_idempotent(p.req_->method())) {
+      // The worker may have executed it already: don't repeat side effects.
+      auto const& req = *p.req_;
+      p.cb_(string_response(req, "Worker failed", http::status::bad_gateway,
+                            "text/plain"));
+    } else if (p.attempts_ < settings_.max_attempts_) {
+      p.res_.reset();
+      dispatch(std::move(p));
+    } else {
+      auto const& req = *p.req_;
+      p.cb_(string_response(req, "Worker failed", http::status::bad_gateway,
+                            "text/plain"));
+    }
+  }
+
+  std::optional<pending_request> extract(worker& w, std::uint32_t const id) {
+    auto const lock = std::lock_guard{w.mutex_};
+    auto const it = w.pending_.find(id);
+    if (it == end(w.pending_)) {
+      return std::nullopt;
+    }
+    auto p = std::move(it->second);
+    w.pending_.erase(it);
+    --w.outstanding_;
+    cancel_timer(p);
+    return p;
+  }
+
+  void cancel_timer(pending_request& p) {
+    if (auto const timer = std::exchange(p.timer_, nullptr)) {
+      boost::asio::post(strand_, [timer]() { timer->cancel(); });
+    }
+  }
+
+  // The worker did not answer in time: 504, and the worker may stop.
+  void time_out(worker_ptr const& w, std::uint32_t const id) {
+    auto p = extract(*w, id);
+    if (!p.has_value()) {
+      return;
+    }
+    if (auto const session = w->session_.lock()) {
+      session->send(encode_cancel(id), ws_msg_type::BINARY,
+                    [](boost::system::error_code, std::size_t) {});
+    }
+    auto const& req = *p->req_;
+    p->cb_(string_response(req, "Worker timed out",
+                           http::status::gateway_timeout, "text/plain"));
+  }
+
+  void mark_sent(worker& w, std::uint32_t const id) {
+    auto const lock = std::lock_guard{w.mutex_};
+    if (auto const it = w.pending_.find(id); it != end(w.pending_)) {
+      it->second.sent_ = true;
+    }
+  }
+
+  // `received`: the worker has seen the request (e.g. it cancelled it).
+  void fail(worker_ptr const& w, std::uint32_t const id, bool const received) {
+    if (auto p = extract(*w, id)) {
+      p->sent_ = p->sent_ || received;
+      retry(std::move(*p));
+    }
+  }
+
+  void complete(worker_ptr const& w, std::uint32_t const id) {
+    if (auto p = extract(*w, id)) {
+      p->cb_(std::move(*p->res_));
+    }
+  }
+
+  void on_frame(worker_ptr const& w, std::string const& msg) {
+    try {
+      auto const f = decode_frame(msg);
+      auto const end_stream = (f.flags_ & kEndStream) != 0U;
+      switch (f.type_) {
+        case frame_type::kResponse: {
+          auto res = decode_response(f.payload_);
+          {
+            auto const lock = std::lock_guard{w->mutex_};
+            auto const it = w->pending_.find(f.stream_id_);
+            if (it == end(w->pending_)) {
+              break;
+            }
+            it->second.res_ = std::move(res);
+          }
+          if (end_stream) {
+            complete(w, f.stream_id_);
+          }
+          break;
+        }
+
+        case frame_type::kData: {
+          {
+            auto const lock = std::lock_guard{w->mutex_};
+            auto const it = w->pending_.find(f.stream_id_);
+            if (it == end(w->pending_) || !it->second.res_.has_value()) {
+              break;
+            }
+            it->second.res_->body().append(f.payload_);
+          }
+          if (end_stream) {
+            complete(w, f.stream_id_);
+          }
+          break;
+        }
+
+        case frame_type::kLoad: {
+          auto const load = decode_load(f.payload_);
+          w->reported_in_flight_ = load.in_flight_;
+          w->reported_queue_depth_ = load.queue_depth_;
+          break;
+        }
+
+        case frame_type::kCancel: fail(w, f.stream_id_, true); break;
+
+        default:
+          std::cerr << "lb_hub: unexpected frame type "
+                    << static_cast<unsigned>(f.type_) << std::endl;
+      }
+    } catch (std::exception const& e) {
+      std::cerr << "lb_hub: error processing frame: " << e.what()
+                << std::endl;
+    }
+  }
+
+  std::size_t n_workers() {
+    auto const lock = std::lock_guard{mutex_};
+    return workers_.size();
+  }
+
+  lb_hub_settings settings_;
+  boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+  std::atomic_uint32_t next_id_{0U};
+
+  std::mutex mutex_;
+  std::vector<worker_ptr> workers_;
+  std::minstd_rand rng_{std::random_device{}()};
+};
+
+lb_hub::lb_hub(boost::asio::io_context& ioc, lb_hub_settings settings)
+    : impl_{std::make_shared<impl>(ioc, std::move(settings))} {}
+
+lb_hub::~lb_hub() = default;
+
+void lb_hub::attach(web_server& s) const {
+  s.set_ws_subprotocols({std::string{kLbProtocol}});
+  s.on_http_request(
+      [impl = impl_](web_server::http_req_t req, web_server::http_res_cb_t cb,
+                     bool) {
+        impl->dispatch({.req_ = std::make_shared<web_server::http_req_t const>(
+                            std::move(req)),
+                        .cb_ = std::move(cb)});
+      });
+  s.on_upgrade_ok([impl = impl_](web_server::http_req_t const& req) {
+    return impl->upgrade_ok(req);
+  });
+  s.on_ws_open([impl = impl_](ws_session_ptr session,
+                              std::string const& target,
+                              bool) { impl->open(session, target); });
+}
+
+void lb_hub::on_http_request(web_server::http_req_t req,
+                             web_server::http_res_cb_t cb, bool) const {
+  impl_->dispatch(
+      {.req_ = std::make_shared<web_server::http_req_t const>(std::move(req)),
+       .cb_ = std::move(cb)});
+}
+
+bool lb_hub::on_upgrade_ok(web_server::http_req_t const& req) const {
+  return impl_->upgrade_ok(req);
+}
+
+bool lb_hub::on_ws_open(ws_session_ptr const& session,
+                        std::string const& target) const {
+  return impl_->open(session, target);
+}
+
+std::size_t lb_hub::n_workers() const { return impl_->n_workers(); }
+
+}  // namespace net
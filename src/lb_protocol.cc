@@ -0,0 +1,265 @@
+#include "net/lb_protocol.h"
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#include "boost/beast/http.hpp"
+
+#include "utl/verify.h"
+
+namespace http = boost::beast::http;
+
+namespace net {
+
+namespace {
+
+std::string_view to_sv(boost::beast::string_view s) {
+  return {s.data(), s.size()};
+}
+
+boost::beast::string_view to_bsv(std::string_view s) {
+  return {s.data(), s.size()};
+}
+
+template <typename T>
+void append_int(std::string& out, T const x) {
+  for (auto i = 0U; i != sizeof(T); ++i) {
+    out.push_back(static_cast<char>((x >> (8U * i)) & 0xFFU));
+  }
+}
+
+template <typename Int>
+void append_str(std::string& out, std::string_view s) {
+  utl::verify(s.size() <= std::numeric_limits<Int>::max(),
+              "lb frame: string too long [size={}]", s.size());
+  append_int(out, static_cast<Int>(s.size()));
+  out.append(s);
+}
+
+void append_frame_header(std::string& out, frame_type const type,
+                         std::uint8_t const flags,
+                         std::uint32_t const stream_id) {
+  append_int(out, static_cast<std::uint8_t>(type));
+  append_int(out, flags);
+  append_int(out, stream_id);
+}
+
+template <bool IsRequest, typename Fields>
+void append_header_table(std::string& out,
+                         http::header<IsRequest, Fields> const& h) {
+  auto const n = std::distance(h.begin(), h.end());
+  utl::verify(n <= std::numeric_limits<std::uint16_t>::max(),
+              "lb frame: too many headers [n={}]", n);
+  append_int(out, static_cast<std::uint16_t>(n));
+  for (auto const& f : h) {
+    append_str<std::uint16_t>(out, to_sv(f.name_string()));
+    append_str<std::uint32_t>(out, to_sv(f.value()));
+  }
+}
+
+struct reader {
+  template <typename T>
+  T read_int() {
+    utl::verify(in_.size() >= sizeof(T), "lb frame: truncated");
+    auto x = T{0U};
+    for (auto i = 0U; i != sizeof(T); ++i) {
+      x |= static_cast<T>(static_cast<std::uint8_t>(in_[i])) << (8U * i);
+    }
+    in_.remove_prefix(sizeof(T));
+    return x;
+  }
+
+  template <typename Int>
+  std::string_view read_str() {
+    auto const size = read_int<Int>();
+    utl::verify(in_.size() >= size, "lb frame: truncated string");
+    auto const s = in_.substr(0U, size);
+    in_.remove_prefix(size);
+    return s;
+  }
+
+  template <bool IsRequest, typename Fields>
+  void read_header_table(http::header<IsRequest, Fields>& h) {
+    auto const n = read_int<std::uint16_t>();
+    for (auto i = 0U; i != n; ++i) {
+      auto const name = read_str<std::uint16_t>();
+      auto const value = read_str<std::uint32_t>();
+      h.insert(to_bsv(name), to_bsv(value));
+    }
+  }
+
+  std::string_view in_;
+};
+
+}  // namespace
+
+frame decode_frame(std::string_view msg) {
+  auto r = reader{msg};
+  auto const type = r.read_int<std::uint8_t>();
+  auto const flags = r.read_int<std::uint8_t>();
+  auto const stream_id = r.read_int<std::uint32_t>();
+  utl::verify(type >= static_cast<std::uint8_t>(frame_type::kRequest) &&
+                  type <= static_cast<std::uint8_t>(frame_type::kCancel),
+              "lb frame: unknown type {}", type);
+  return {static_cast<frame_type>(type), flags, stream_id, r.in_};
+}
+
+std::string encode_request(std::uint32_t const stream_id,
+                           web_server::http_req_t const& req,
+                           std::chrono::milliseconds const timeout) {
+  auto out = std::string{};
+  out.reserve(kFrameHeaderSize + 512U + req.body().size());
+  append_frame_header(out, frame_type::kRequest, kEndStream, stream_id);
+  append_int(out, static_cast<std::uint32_t>(std::clamp<std::int64_t>(
+                      timeout.count(), 0,
+                      std::numeric_limits<std::uint32_t>::max())));
+  append_str<std::uint16_t>(out, to_sv(req.method_string()));
+  append_str<std::uint32_t>(out, to_sv(req.target()));
+  append_header_table(out, req.base());
+  out.append(req.body());
+  return out;
+}
+
+request_frame decode_request(std::string_view payload) {
+  auto r = reader{payload};
+  auto f = request_frame{};
+  f.timeout_ = std::chrono::milliseconds{r.read_int<std::uint32_t>()};
+  f.req_.version(11);
+  f.req_.method_string(to_bsv(r.read_str<std::uint16_t>()));
+  f.req_.target(to_bsv(r.read_str<std::uint32_t>()));
+  r.read_header_table(f.req_.base());
+  f.req_.body() = std::string{r.in_};
+  return f;
+}
+
+response_encoder::response_encoder(std::uint32_t const stream_id,
+                                   web_server::http_res_t&& res,
+                                   std::size_t const max_chunk)
+    : stream_id_{stream_id}, res_{std::move(res)}, max_chunk_{max_chunk} {
+  std::visit(
+      [&](auto& x) {
+        using body_t = typename std::decay_t<decltype(x)>::body_type;
+        x.prepare_payload();
+        if constexpr (std::is_same_v<body_t, http::string_body>) {
+          size_ = x.body().size();
+        } else if constexpr (std::is_same_v<body_t, http::buffer_body>) {
+          size_ = x.body().data == nullptr ? 0U : x.body().size;
+        } else if constexpr (std::is_same_v<body_t, http::file_body>) {
+          size_ = x.body().size();
+          auto ec = boost::beast::error_code{};
+          x.body().file().seek(0U, ec);
+          if (ec) {
+            throw boost::system::system_error{ec};
+          }
+        }
+      },
+      res_);
+}
+
+std::string_view response_encoder::read_chunk() {
+  auto const n =
+      static_cast<std::size_t>(std::min<std::uint64_t>(size_ - offset_,
+                                                       max_chunk_));
+  auto const chunk = std::visit(
+      [&](auto& x) -> std::string_view {
+        using body_t = typename std::decay_t<decltype(x)>::body_type;
+        if constexpr (std::is_same_v<body_t, http::string_body>) {
+          return std::string_view{x.body()}.substr(offset_, n);
+        } else if constexpr (std::is_same_v<body_t, http::buffer_body>) {
+          return {static_cast<char const*>(x.body().data) + offset_, n};
+        } else if constexpr (std::is_same_v<body_t, http::file_body>) {
+          auto ec = boost::beast::error_code{};
+          buf_.resize(n);
+          auto read = std::size_t{0U};
+          while (read != n) {
+            auto const r =
+                x.body().file().read(buf_.data() + read, n - read, ec);
+            if (ec) {
+              throw boost::system::system_error{ec};
+            }
+            utl::verify(r != 0U, "lb: unexpected end of file");
+            read += r;
+          }
+          return buf_;
+        } else {
+          return {};
+        }
+      },
+      res_);
+  offset_ += chunk.size();
+  return chunk;
+}
+
+std::string response_encoder::next() {
+  auto const chunk = read_chunk();
+  auto const flags = offset_ == size_ ? kEndStream : kNoFlags;
+  done_ = offset_ == size_;
+
+  auto out = std::string{};
+  if (!header_sent_) {
+    header_sent_ = true;
+    out.reserve(kFrameHeaderSize + 512U + chunk.size());
+    append_frame_header(out, frame_type::kResponse, flags, stream_id_);
+    std::visit(
+        [&](auto& x) {
+          append_int(out, static_cast<std::uint16_t>(x.result_int()));
+          append_header_table(out, x.base());
+        },
+        res_);
+    out.append(chunk);
+  } else {
+    out = encode_data(stream_id_, flags, chunk);
+  }
+  return out;
+}
+
+web_server::string_res_t decode_response(std::string_view payload) {
+  auto r = reader{payload};
+  auto res = web_server::string_res_t{};
+  res.version(11);
+  res.result(r.read_int<std::uint16_t>());
+  r.read_header_table(res.base());
+  res.body() = std::string{r.in_};
+  return res;
+}
+
+std::string encode_data(std::uint32_t const stream_id,
+                        std::uint8_t const flags, std::string_view data) {
+  auto out = std::string{};
+  out.reserve(kFrameHeaderSize + data.size());
+  append_frame_header(out, frame_type::kData, flags, stream_id);
+  out.append(data);
+  return out;
+}
+
+std::string encode_load(load_report const& r) {
+  auto out = std::string{};
+  out.reserve(kFrameHeaderSize + 16U);
+  append_frame_header(out, frame_type::kLoad, kNoFlags, 0U);
+  append_int(out, r.in_flight_);
+  append_int(out, r.queue_depth_);
+  append_int(out, r.latency_us_);
+  append_int(out, r.cpu_permille_);
+  append_int(out, r.load_avg_pct_);
+  return out;
+}
+
+std::string encode_cancel(std::uint32_t const stream_id) {
+  auto out = std::string{};
+  append_frame_header(out, frame_type::kCancel, kNoFlags, stream_id);
+  return out;
+}
+
+load_report decode_load(std::string_view payload) {
+  auto r = reader{payload};
+  auto l = load_report{};
+  l.in_flight_ = r.read_int<std::uint32_t>();
+  l.queue_depth_ = r.read_int<std::uint32_t>();
+  l.latency_us_ = r.read_int<std::uint32_t>();
+  l.cpu_permille_ = r.read_int<std::uint16_t>();
+  l.load_avg_pct_ = r.read_int<std::uint16_t>();
+  return l;
+}
+
+}  // namespace net
@@ -5,20 +5,20 @@
 namespace net {
 
 ssl::ssl(boost::asio::io_context& io_context, std::string host,
-         std::string port, boost::posix_time::time_duration const& timeout)
-    : ctx_(boost::asio::ssl::context::sslv23),
-      resolver_(io_context),
-      socket_(io_context, ctx_),
-      req_timeout_timer_(io_context, timeout),
+         std::string port, boost::posix_time::time_duration const& timeout,
+         std::shared_ptr<ssl_client_context> ctx)
+    : ctx_(std::move(ctx)),
+      session_key_(host + ":" + port),
+      dns_(dns_cache::shared()),
+      socket_(io_context, ctx_->get()),
+      req_timeout_timer_(io_context),
+      timeout_(timeout),
       host_(std::move(host)),
       port_(std::move(port)),
-      connected_(false) {
-  boost::system::error_code ignore;
-  ctx_.set_verify_mode(boost::asio::ssl::verify_none, ignore);
-  ctx_.set_options(boost::asio::ssl::context::default_workarounds |
-                   boost::asio::ssl::context::no_sslv2 |
-                   boost::asio::ssl::context::no_sslv3 |
-                   boost::asio::ssl::context::single_dh_use);
+      connected_(false),
+      aborted_(false) {
+  ctx_->prepare(socket_.native_handle(), &session_key_);
+
   // https://stackoverflow.com/a/59225060
   // SSL SNI extension
   // NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast)
@@ -35,15 +35,27 @@ ssl::~ssl() {
 }
 
 void ssl::connect(connect_cb cb) {
+  aborted_ = false;
+  // Armed per request: pooled connections serve several requests.
+  req_timeout_timer_.expires_from_now(timeout_);
   req_timeout_timer_.async_wait(
-      [me = shared_from_this()](boost::system::error_code const& ec) {
-        me->timer_callback(me, ec);
+      [me = shared_from_this(), generation = ++timeout_generation_](
+          boost::system::error_code const& ec) {
+        // A handler of an earlier request may still be queued: the timer
+        // expired before it was re-armed or cancelled.
+        if (generation == me->timeout_generation_) {
+          me->timer_callback(me, ec);
+        }
       });
   return connect(shared_from_this(), std::move(cb));
 }
 
 void ssl::cancel() {
   connected_ = false;
+  aborted_ = true;
+  if (connecting_ != nullptr) {
+    connecting_->cancel();
+  }
   boost::system::error_code ignored;
   socket_.lowest_layer().shutdown(boost::asio::ip::tcp::socket::shutdown_both,
                                   ignored);
@@ -59,24 +71,33 @@ void ssl::connect(ssl_ptr self, connect_cb cb) {
 }
 
 void ssl::resolve(ssl_ptr self, connect_cb cb) {
-  boost::asio::ip::tcp::resolver::query const query(host_, port_);
-  return resolver_.async_resolve(
-      query, [self = std::move(self), cb = std::move(cb)](
-                 boost::system::error_code const& ec,
-                 boost::asio::ip::tcp::resolver::iterator it) mutable {
-        self->on_resolve(self, std::move(cb), ec, std::move(it));
+  auto const executor = socket_.get_executor();
+  return dns_->resolve(
+      executor, host_, port_,
+      [self = std::move(self), cb = std::move(cb)](
+          boost::system::error_code const& ec,
+          dns_cache::endpoints endpoints) mutable {
+        self->on_resolve(self, std::move(cb), ec, std::move(endpoints));
       });
 }
 
 void ssl::on_resolve(ssl_ptr self, connect_cb cb, boost::system::error_code ec,
-                     boost::asio::ip::tcp::resolver::iterator iterator) {
+                     dns_cache::endpoints endpoints) {
+  if (!ec && aborted_) {
+    ec = boost::asio::error::operation_aborted;  // cancelled while resolving
+  }
+
   if (!ec) {
-    return boost::asio::async_connect(
-        socket_.lowest_layer(), std::move(iterator),
+    connecting_ = happy_eyeballs::connect(
+        socket_.get_executor(), endpoints,
         [self = std::move(self), cb = std::move(cb)](
-            boost::system::error_code ec,
-            boost::asio::ip::tcp::resolver::iterator const& it) {
-          self->on_connect(self, cb, ec, it);
+            boost::system::error_code const& ec,
+            boost::asio::ip::tcp::socket s) {
+          self->connecting_.reset();
+          if (!ec) {
+            self->socket_.next_layer() = std::move(s);
+          }
+          self->on_connect(self, cb, ec);
         });
   } else {
     finally(ec);
@@ -85,8 +106,7 @@ void ssl::on_resolve(ssl_ptr self, connect_cb cb, boost::system::error_code ec,
 }
 
 void ssl::on_connect(ssl_ptr const& self, const connect_cb& cb,
-                     boost::system::error_code ec,
-                     boost::asio::ip::tcp::resolver::iterator const&) {
+                     boost::system::error_code ec) {
   if (!ec) {
     return socket_.async_handshake(boost::asio::ssl::stream_base::client,
                                    [self, cb](boost::system::error_code ec) {
@@ -103,6 +123,7 @@ void ssl::on_handshake(ssl_ptr self, const connect_cb& cb,
   if (!ec) {
     connected_ = true;
   } else {
+    ctx_->forget(session_key_);
     finally(ec);
   }
   return cb(std::move(self), ec);
@@ -115,6 +136,7 @@ void ssl::timer_callback(ssl_ptr const&, boost::system::error_code const& ec) {
 }
 
 void ssl::finally(boost::system::error_code const& ec) {
+  ++timeout_generation_;
   req_timeout_timer_.cancel();
   if (ec == boost::asio::error::eof) {
     connected_ = false;
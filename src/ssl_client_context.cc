@@ -0,0 +1,109 @@
+#include "net/ssl_client_context.h"
+
+namespace net {
+
+namespace {
+
+// OpenSSL application data slots (asio uses the plain app data itself).
+int context_index() {
+  static int const idx =
+      SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return idx;
+}
+
+int key_index() {
+  static int const idx =
+      SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return idx;
+}
+
+}  // namespace
+
+ssl_client_context::ssl_client_context(std::size_t const max_sessions)
+    : ctx_(boost::asio::ssl::context::sslv23), max_sessions_(max_sessions) {
+  boost::system::error_code ignore;
+  ctx_.set_verify_mode(boost::asio::ssl::verify_none, ignore);
+  ctx_.set_options(boost::asio::ssl::context::default_workarounds |
+                   boost::asio::ssl::context::no_sslv2 |
+                   boost::asio::ssl::context::no_sslv3 |
+                   boost::asio::ssl::context::single_dh_use);
+
+  auto const native = ctx_.native_handle();
+  SSL_CTX_set_ex_data(native, context_index(), this);
+  SSL_CTX_set_session_cache_mode(
+      native, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(native, &ssl_client_context::on_new_session);
+}
+
+ssl_client_context::~ssl_client_context() {
+  for (auto const& s : sessions_) {
+    SSL_SESSION_free(s.session_);
+  }
+}
+
+std::shared_ptr<ssl_client_context> const& ssl_client_context::shared() {
+  static auto const ctx = std::make_shared<ssl_client_context>();
+  return ctx;
+}
+
+void ssl_client_context::prepare(SSL* ssl, std::string const* key) {
+  SSL_set_ex_data(ssl, key_index(), const_cast<std::string*>(key));
+
+  std::lock_guard<std::mutex> const lock{mutex_};
+  auto const it = index_.find(*key);
+  if (it != end(index_)) {
+    sessions_.splice(begin(sessions_), sessions_, it->second);
+
+    // Connections closed without TLS shutdown invalidate their session:
+    // hand out copies and keep the cached one intact.
+    auto const copy = SSL_SESSION_dup(it->second->session_);
+    if (copy != nullptr) {
+      SSL_set_session(ssl, copy);
+      SSL_SESSION_free(copy);  // SSL_set_session took its own reference
+    }
+  }
+}
+
+void ssl_client_context::forget(std::string const& key) {
+  std::lock_guard<std::mutex> const lock{mutex_};
+  auto const it = index_.find(key);
+  if (it != end(index_)) {
+    SSL_SESSION_free(it->second->session_);
+    sessions_.erase(it->second);
+    index_.erase(it);
+  }
+}
+
+int ssl_client_context::on_new_session(SSL* ssl, SSL_SESSION* session) {
+  auto const ctx = static_cast<ssl_client_context*>(
+      SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), context_index()));
+  auto const key = static_cast<std::string*>(SSL_get_ex_data(ssl, key_index()));
+  if (ctx != nullptr && key != nullptr && SSL_SESSION_is_resumable(session)) {
+    // Copy: `session` belongs to the connection (see prepare()).
+    if (auto const copy = SSL_SESSION_dup(session); copy != nullptr) {
+      ctx->store(*key, copy);
+    }
+  }
+  return 0;  // not taken: OpenSSL keeps ownership of `session`
+}
+
+void ssl_client_context::store(std::string const& key, SSL_SESSION* session) {
+  std::lock_guard<std::mutex> const lock{mutex_};
+  auto const it = index_.find(key);
+  if (it != end(index_)) {
+    SSL_SESSION_free(it->second->session_);
+    it->second->session_ = session;
+    sessions_.splice(begin(sessions_), sessions_, it->second);
+    return;
+  }
+  if (sessions_.size() >= max_sessions_ && !sessions_.empty()) {
+    auto const& lru = sessions_.back();
+    SSL_SESSION_free(lru.session_);
+    index_.erase(lru.key_);
+    sessions_.pop_back();
+  }
+  sessions_.push_front({key, session});
+  index_.emplace(key, begin(sessions_));
+}
+
+}  // namespace net
@@ -6,22 +6,25 @@ namespace net {
 
 tcp::tcp(asio::io_context& ios, std::string host, std::string port,
          boost::posix_time::time_duration const& timeout)
-    : resolver_(ios),
+    : dns_(dns_cache::shared()),
       socket_(ios),
-      req_timeout_timer_(ios, timeout),
+      req_timeout_timer_(ios),
+      timeout_(timeout),
       host_(std::move(host)),
       port_(std::move(port)),
       use_timeout_(true),
-      connected_(false) {}
+      connected_(false),
+      aborted_(false) {}
 
 tcp::tcp(asio::io_context& ios, std::string host, std::string port)
-    : resolver_(ios),
+    : dns_(dns_cache::shared()),
       socket_(ios),
       req_timeout_timer_(ios),
       host_(std::move(host)),
       port_(std::move(port)),
       use_timeout_(false),
-      connected_(false) {}
+      connected_(false),
+      aborted_(false) {}
 
 tcp::~tcp() {
   if (connected_) {
@@ -30,10 +33,18 @@ tcp::~tcp() {
 }
 
 void tcp::connect(connect_cb cb) {
+  aborted_ = false;
   if (use_timeout_) {
+    // Armed per request: pooled connections serve several requests.
+    req_timeout_timer_.expires_from_now(timeout_);
     req_timeout_timer_.async_wait(
-        [me = shared_from_this()](boost::system::error_code const& ec) {
-          me->timer_callback(me, ec);
+        [me = shared_from_this(), generation = ++timeout_generation_](
+            boost::system::error_code const& ec) {
+          // A handler of an earlier request may still be queued: the timer
+          // expired before it was re-armed or cancelled.
+          if (generation == me->timeout_generation_) {
+            me->timer_callback(me, ec);
+          }
         });
   }
   return connect(shared_from_this(), std::move(cb));
@@ -41,6 +52,10 @@ void tcp::connect(connect_cb cb) {
 
 void tcp::cancel() {
   connected_ = false;
+  aborted_ = true;
+  if (connecting_ != nullptr) {
+    connecting_->cancel();
+  }
   boost::system::error_code ignored;
   socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ignored);
   socket_.close(ignored);
@@ -55,26 +70,32 @@ void tcp::connect(tcp_ptr self, connect_cb cb) {
 }
 
 void tcp::resolve(tcp_ptr self, connect_cb cb) {
-  asio::ip::tcp::resolver::query const query(
-      asio::ip::tcp::v4(), host_, port_,
-      asio::ip::resolver_query_base::flags());
-  return resolver_.async_resolve(
-      query, [self = std::move(self), cb = std::move(cb)](
-                 boost::system::error_code ec,
-                 asio::ip::tcp::resolver::iterator iterator) mutable {
-        self->on_resolve(self, std::move(cb), ec, std::move(iterator));
+  auto const executor = socket_.get_executor();
+  return dns_->resolve(
+      executor, host_, port_,
+      [self = std::move(self), cb = std::move(cb)](
+          boost::system::error_code const& ec,
+          dns_cache::endpoints endpoints) mutable {
+        self->on_resolve(self, std::move(cb), ec, std::move(endpoints));
       });
 }
 
 void tcp::on_resolve(tcp_ptr self, connect_cb cb, boost::system::error_code ec,
-                     asio::ip::tcp::resolver::iterator iterator) {
+                     dns_cache::endpoints endpoints) {
+  if (!ec && aborted_) {
+    ec = asio::error::operation_aborted;  // cancelled while resolving
+  }
+
   if (!ec) {
-    return asio::async_connect(
-        socket_, std::move(iterator),
+    connecting_ = happy_eyeballs::connect(
+        socket_.get_executor(), endpoints,
         [self = std::move(self), cb = std::move(cb)](
-            boost::system::error_code const& ec,
-            asio::ip::tcp::resolver::iterator const& it) {
-          self->on_connect(self, cb, ec, it);
+            boost::system::error_code const& ec, asio::ip::tcp::socket s) {
+          self->connecting_.reset();
+          if (!ec) {
+            self->socket_ = std::move(s);
+          }
+          self->on_connect(self, cb, ec);
         });
   } else {
     finally(ec);
@@ -83,8 +104,7 @@ void tcp::on_resolve(tcp_ptr self, connect_cb cb, boost::system::error_code ec,
 }
 
 void tcp::on_connect(tcp_ptr self, const connect_cb& cb,
-                     boost::system::error_code ec,
-                     asio::ip::tcp::resolver::iterator const&) {
+                     boost::system::error_code ec) {
   if (!ec) {
     connected_ = true;
   } else {
@@ -100,6 +120,7 @@ void tcp::timer_callback(tcp_ptr const&, boost::system::error_code const& ec) {
 }
 
 void tcp::finally(boost::system::error_code const& ec) {
+  ++timeout_generation_;
   req_timeout_timer_.cancel();
   if (ec == asio::error::eof) {
     connected_ = false;
@@ -1,7 +1,9 @@
 #include "net/web_server/detect_session.h"
 
+#include <cstdint>
 #include <memory>
 
+#include "boost/asio/post.hpp"
 #include "boost/beast/core.hpp"
 #include "boost/beast/http.hpp"
 
@@ -11,22 +13,28 @@
 
 #include "net/web_server/fail.h"
 #include "net/web_server/http_session.h"
+#include "net/web_server/timer_wheel.h"
 #include "net/web_server/web_server.h"
 
 namespace net {
 
 #if defined(NET_TLS)
 // Detects SSL handshakes
-struct detect_session : public std::enable_shared_from_this<detect_session> {
+struct detect_session : public timeout_target,
+                        public std::enable_shared_from_this<detect_session> {
   explicit detect_session(boost::asio::ip::tcp::socket&& socket,
                           boost::asio::ssl::context& ctx,
                           web_server_settings_ptr settings)
-      : stream_(std::move(socket)), ctx_(ctx), settings_(std::move(settings)) {}
+      : stream_(std::move(socket)),
+        executor_(stream_.get_executor()),
+        ctx_(ctx),
+        settings_(std::move(settings)) {}
 
   // Launch the detector
   void run() {
     // Set the timeout.
-    stream_.expires_after(settings_->timeout_);
+    settings_->timer_wheel_->arm(timeout_, weak_from_this(),
+                                 ++timeout_generation_, settings_->timeout_);
 
     boost::beast::async_detect_ssl(
         stream_, buffer_,
@@ -34,7 +42,19 @@ struct detect_session : public std::enable_shared_from_this<detect_session> {
                                          this->shared_from_this()));
   }
 
+  void on_timeout(std::uint64_t const generation) override {
+    boost::asio::post(executor_,
+                      [self = shared_from_this(), generation]() {
+                        if (generation == self->timeout_generation_) {
+                          self->stream_.close();
+                        }
+                      });
+  }
+
   void on_detect(boost::beast::error_code ec, bool result) {
+    ++timeout_generation_;
+    timeout_.cancel();
+
     if (ec) {
       return fail(ec, "detect");
     }
@@ -51,10 +71,13 @@ struct detect_session : public std::enable_shared_from_this<detect_session> {
 
 private:
   boost::beast::tcp_stream stream_;
+  boost::beast::tcp_stream::executor_type executor_;
+  std::uint64_t timeout_generation_{0U};
   boost::asio::ssl::context& ctx_;
   boost::beast::flat_buffer buffer_;
 
   web_server_settings_ptr settings_;
+  timer_wheel::timer timeout_;  // destroyed before settings_ (the wheel)
 };
 
 void make_detect_session(boost::asio::ip::tcp::socket&& socket,
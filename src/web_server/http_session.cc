@@ -1,19 +1,26 @@
 #include "net/web_server/http_session.h"
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <utility>
 #include <vector>
 
+#include "boost/asio/dispatch.hpp"
+#include "boost/asio/post.hpp"
 #include "boost/beast/core/bind_handler.hpp"
+#include "boost/beast/core/read_size.hpp"
 #include "boost/beast/http.hpp"
 #include "boost/beast/websocket/rfc6455.hpp"
 #if defined(NET_TLS)
 #include "boost/beast/ssl.hpp"
 #endif
 
+#include "net/web_server/compact_buffer.h"
 #include "net/web_server/fail.h"
 #include "net/web_server/responses.h"
+#include "net/web_server/timer_wheel.h"
 #include "net/web_server/web_server.h"
 #include "net/web_server/websocket_session.h"
 
@@ -29,7 +36,7 @@ void reset(T& t) {
 // This uses the Curiously Recurring Template Pattern so that
 // the same code works with both SSL streams and regular sockets.
 template <class Derived>
-struct http_session {
+struct http_session : public timeout_target {
   // Access the derived class, this is part of
   // the Curiously Recurring Template Pattern idiom.
   Derived& derived() { return static_cast<Derived&>(*this); }
@@ -100,6 +107,8 @@ struct http_session {
               : self_(self), msg_(std::move(msg)) {}
 
           void send() override {
+            self_.arm_timeout(self_.write_deadline_,
+                              self_.settings_->write_timeout_);
             boost::beast::http::async_write(
                 self_.derived().stream(), msg_,
                 boost::beast::bind_front_handler(
@@ -108,6 +117,10 @@ struct http_session {
           }
         };
 
+        if (close_) {
+          // Last request allowed on this connection.
+          msg.keep_alive(false);
+        }
         response_ = std::make_unique<response_impl>(self_, std::move(msg));
         boost::asio::post(self_.derived().stream().get_executor(),
                           [&, self = self_.derived().shared_from_this()]() {
@@ -117,6 +130,7 @@ struct http_session {
 
       http_session& self_;
       std::unique_ptr<response> response_;
+      bool close_{false};
     };
 
     pending_request& add_entry() {
@@ -131,12 +145,53 @@ struct http_session {
   };
 
   // Construct the session
-  http_session(boost::beast::flat_buffer buffer,
+  http_session(boost::beast::tcp_stream::executor_type executor,
+               boost::beast::flat_buffer buffer,
                web_server_settings_ptr settings)
       : queue_(*this, settings->request_queue_limit_),
+        executor_(std::move(executor)),
         buffer_(std::move(buffer)),
         settings_(std::move(settings)) {}
 
+  // Timeouts are tracked by the shared timer wheel instead of the
+  // per-stream timer. Reads and writes may overlap (pipelining), so each
+  // has its own wheel timer and generation.
+  struct deadline {
+    timer_wheel::timer timer_;
+    std::uint64_t generation_{0U};
+  };
+
+  void arm_timeout(deadline& t, std::chrono::nanoseconds const duration) {
+    t.generation_ = ++timeout_generation_;
+    settings_->timer_wheel_->arm(t.timer_, derived().weak_from_this(),
+                                 t.generation_, duration);
+  }
+
+  static void disarm(deadline& t) {
+    t.generation_ = 0U;
+    t.timer_.cancel();
+  }
+
+  void cancel_timeouts() {
+    disarm(read_deadline_);
+    disarm(write_deadline_);
+  }
+
+  void on_timeout(std::uint64_t const generation) override {
+    boost::asio::post(executor_, [self = derived().shared_from_this(),
+                                  generation]() {
+      if (generation == self->read_deadline_.generation_ ||
+          generation == self->write_deadline_.generation_) {
+        boost::beast::get_lowest_layer(self->stream()).close();
+      }
+    });
+  }
+
+  bool request_limit_reached() const {
+    return settings_->max_requests_per_connection_ != 0U &&
+           n_requests_ >= settings_->max_requests_per_connection_;
+  }
+
   void do_read() {
     // Construct a new parser for each message
     reset(parser_);
@@ -145,20 +200,77 @@ struct http_session {
     // of the body in bytes to prevent abuse.
     parser_.body_limit(settings_->request_body_limit_);
 
-    // Set the timeout.
+    // Nothing pipelined: the connection goes idle until the next request.
+    compact_buffer(buffer_, settings_->idle_buffer_limit_);
+
+    body_started_ = false;
+    if (buffer_.size() != 0U) {
+      // Pipelined bytes are already there: the header timeout applies.
+      arm_timeout(read_deadline_, settings_->header_timeout_);
+      return do_read_some();
+    }
+
+    // Idle keep-alive timeout until the first byte of the next request.
+    arm_timeout(read_deadline_, settings_->idle_timeout_);
+    if (derived().is_ssl()) {
+      // TLS may hold buffered records the socket does not report.
+      return read_first_bytes();
+    }
+
+    // Plain TCP: wait for data without holding a read buffer. The read
+    // allocates it again once the next request arrives.
+    buffer_.shrink_to_fit();
     boost::beast::get_lowest_layer(derived().stream())
-        .expires_after(settings_->timeout_);
+        .socket()
+        .async_wait(boost::asio::socket_base::wait_read,
+                    boost::beast::bind_front_handler(
+                        &http_session::on_readable,
+                        derived().shared_from_this()));
+  }
+
+  void on_readable(boost::beast::error_code ec) {
+    if (ec) {
+      return fail(ec, "read");
+    }
+    read_first_bytes();
+  }
+
+  // The parser only completes a read once the full header is there, so
+  // the first bytes are read directly to switch to the header timeout.
+  void read_first_bytes() {
+    derived().stream().async_read_some(
+        buffer_.prepare(boost::beast::read_size(buffer_, kMaxReadSize)),
+        boost::beast::bind_front_handler(&http_session::on_first_bytes,
+                                         derived().shared_from_this()));
+  }
 
+  void on_first_bytes(boost::beast::error_code ec,
+                      std::size_t bytes_transferred) {
+    buffer_.commit(bytes_transferred);
+
+    // This means they closed the connection
+    if (ec == boost::asio::error::eof) {
+      return derived().do_eof();
+    }
+
+    if (ec) {
+      return fail(ec, "read");
+    }
+
+    // The header timeout covers the whole header, starting at its first byte.
+    arm_timeout(read_deadline_, settings_->header_timeout_);
+    do_read_some();
+  }
+
+  void do_read_some() {
     // Read a request using the parser-oriented interface
-    boost::beast::http::async_read(
+    boost::beast::http::async_read_some(
         derived().stream(), buffer_, parser_,
         boost::beast::bind_front_handler(&http_session::on_read,
                                          derived().shared_from_this()));
   }
 
   void on_read(boost::beast::error_code ec, std::size_t bytes_transferred) {
-    boost::ignore_unused(bytes_transferred);
-
     // This means they closed the connection
     if (ec == boost::beast::http::error::end_of_stream) {
       return derived().do_eof();
@@ -168,13 +280,35 @@ struct http_session {
       return fail(ec, "read");
     }
 
+    if (!parser_.is_done()) {
+      if (!body_started_) {
+        body_started_ = true;
+        body_start_ = std::chrono::steady_clock::now();
+        body_bytes_ = 0U;
+        arm_timeout(read_deadline_, settings_->body_timeout_);
+      } else {
+        body_bytes_ += bytes_transferred;
+        if (body_too_slow()) {
+          cancel_timeouts();
+          boost::beast::get_lowest_layer(derived().stream()).close();
+          return;
+        }
+        // The body timeout limits the time without any progress.
+        arm_timeout(read_deadline_, settings_->body_timeout_);
+      }
+      return do_read_some();
+    }
+
+    disarm(read_deadline_);
+    ++n_requests_;
+
     // See if it is a WebSocket Upgrade
     if (boost::beast::websocket::is_upgrade(parser_.get())) {
       if (!settings_->ws_upgrade_ok_ ||
           settings_->ws_upgrade_ok_(parser_.get())) {
         // Disable the timeout.
         // The websocket::stream uses its own timeout settings.
-        boost::beast::get_lowest_layer(derived().stream()).expires_never();
+        cancel_timeouts();
 
         // Create a websocket session, transferring ownership
         // of both the socket and the HTTP request.
@@ -186,12 +320,18 @@ struct http_session {
       }
     } else {
       auto& queue_entry = queue_.add_entry();
+      queue_entry.close_ = request_limit_reached();
       if (settings_->http_req_cb_) {
+        // Handlers may respond from any thread (e.g. a worker pool).
         settings_->http_req_cb_(
             parser_.release(),
             [self = derived().shared_from_this(),
              &queue_entry](web_server::http_res_t&& res) {
-              std::visit(queue_entry, std::move(res));
+              boost::asio::dispatch(
+                  self->executor_,
+                  [self, &queue_entry, res = std::move(res)]() mutable {
+                    std::visit(queue_entry, std::move(res));
+                  });
             },
             derived().is_ssl());
       } else {
@@ -201,16 +341,31 @@ struct http_session {
     }
 
     // If we aren't at the queue limit, try to pipeline another request
-    if (!queue_.is_full()) {
+    if (!queue_.is_full() && !request_limit_reached()) {
       do_read();
     }
   }
 
+  // Slowloris protection: the body has to arrive with a minimum average
+  // rate. Checked only after the first second to tolerate slow starts.
+  bool body_too_slow() const {
+    if (settings_->body_min_rate_ == 0U) {
+      return false;
+    }
+    auto const elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - body_start_);
+    return elapsed.count() >= 1.0 &&
+           static_cast<double>(body_bytes_) <
+               static_cast<double>(settings_->body_min_rate_) *
+                   elapsed.count();
+  }
+
   void on_write(bool close, boost::beast::error_code ec,
                 std::size_t bytes_transferred) {
     boost::ignore_unused(bytes_transferred);
 
     write_active_ = false;
+    disarm(write_deadline_);
     if (ec) {
       return fail(ec, "write");
     }
@@ -222,7 +377,7 @@ struct http_session {
     }
 
     // Inform the queue that a write completed
-    if (queue_.on_write()) {
+    if (queue_.on_write() && !request_limit_reached()) {
       // Read another request
       do_read();
     }
@@ -235,14 +390,28 @@ struct http_session {
     queue_.send_next();
   }
 
+  static constexpr auto const kMaxReadSize = std::size_t{65536U};
+
   queue queue_;
   bool write_active_{false};
 
+  boost::beast::tcp_stream::executor_type executor_;
+  std::uint64_t timeout_generation_{0U};
+
+  std::size_t n_requests_{0U};
+  bool body_started_{false};
+  std::chrono::steady_clock::time_point body_start_;
+  std::size_t body_bytes_{0U};
+
   boost::beast::flat_buffer buffer_;
 
   boost::beast::http::request_parser<boost::beast::http::string_body> parser_;
 
   web_server_settings_ptr settings_;
+
+  // Destroyed before settings_, which may hold the last wheel reference.
+  deadline read_deadline_;
+  deadline write_deadline_;
 };
 
 //------------------------------------------------------------------------------
@@ -255,8 +424,8 @@ struct plain_http_session
   plain_http_session(boost::beast::tcp_stream&& stream,
                      boost::beast::flat_buffer&& buffer,
                      web_server_settings_ptr settings)
-      : http_session<plain_http_session>(std::move(buffer),
-                                         std::move(settings)),
+      : http_session<plain_http_session>(
+            stream.get_executor(), std::move(buffer), std::move(settings)),
         stream_(std::move(stream)) {}
 
   // Start the session
@@ -304,13 +473,19 @@ struct ssl_http_session
                    boost::asio::ssl::context& ctx,
                    boost::beast::flat_buffer&& buffer,
                    web_server_settings_ptr settings)
-      : http_session<ssl_http_session>(std::move(buffer), std::move(settings)),
-        stream_(std::move(stream), ctx) {}
+      : http_session<ssl_http_session>(
+            stream.get_executor(), std::move(buffer), std::move(settings)),
+        stream_(std::move(stream), ctx) {
+    // OpenSSL frees its read/write record buffers (~34 KiB) whenever they
+    // are empty, so idle connections (and WebSockets upgraded from them)
+    // don't hold them. Set per connection: the context is the caller's.
+    SSL_set_mode(stream_.native_handle(), SSL_MODE_RELEASE_BUFFERS);
+  }
 
   // Start the session
   void run() {
     // Set the timeout.
-    boost::beast::get_lowest_layer(stream_).expires_after(settings_->timeout_);
+    arm_timeout(read_deadline_, settings_->timeout_);
 
     // Perform the SSL handshake
     // Note, this is the buffered version of the handshake.
@@ -333,10 +508,11 @@ struct ssl_http_session
   // Called by the base class
   void do_eof() {
     // Set the timeout.
-    boost::beast::get_lowest_layer(stream_).expires_after(settings_->timeout_);
+    arm_timeout(write_deadline_, settings_->timeout_);
 
     // Perform the SSL shutdown
-    stream_.async_shutdown(ssl_http_session::on_shutdown);
+    stream_.async_shutdown(boost::beast::bind_front_handler(
+        &ssl_http_session::on_shutdown, shared_from_this()));
   }
 
   static bool is_ssl() { return true; }
@@ -353,7 +529,9 @@ private:
     do_read();
   }
 
-  static void on_shutdown(boost::beast::error_code ec) {
+  void on_shutdown(boost::beast::error_code ec) {
+    cancel_timeouts();
+
     if (ec) {
       return fail(ec, "shutdown");
     }
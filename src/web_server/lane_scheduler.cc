@@ -0,0 +1,104 @@
+#include "net/web_server/lane_scheduler.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace net {
+
+lane_scheduler::lane_scheduler(work_stealing_pool& pool,
+                               lane_settings settings)
+    : pool_{pool}, settings_{std::move(settings)} {
+  if (settings_.max_running_ == 0U) {
+    settings_.max_running_ = pool_.size();
+  }
+  for (auto& w : settings_.weights_) {
+    w = std::max(w, 1U);
+  }
+  credits_ = settings_.weights_;
+}
+
+std::shared_ptr<lane_scheduler::route_state> lane_scheduler::add_route(
+    route_options options) {
+  return std::make_shared<route_state>(std::move(options));
+}
+
+bool lane_scheduler::submit(std::shared_ptr<route_state> const& route,
+                            task_t task) {
+  auto lock = std::unique_lock{mutex_};
+  auto const l = lane(*route);
+  if (settings_.max_queued_ != 0U && queued_[l] >= settings_.max_queued_) {
+    return false;
+  }
+
+  ++queued_[l];
+  auto const max = route->options_.max_concurrency_;
+  if (max == 0U || route->admitted_ < max) {
+    ++route->admitted_;
+    lanes_[l].push_back({route, std::move(task)});
+  } else {
+    route->blocked_.push_back(std::move(task));
+  }
+  schedule(lock);
+  return true;
+}
+
+// Weighted round-robin: each lane may take as many tasks as its weight,
+// credits are refilled once no lane with work has any left.
+std::optional<lane_scheduler::entry> lane_scheduler::next() {
+  for (auto round = 0U; round != 2U; ++round) {
+    for (auto l = 0U; l != lanes_.size(); ++l) {
+      if (!lanes_[l].empty() && credits_[l] != 0U) {
+        --credits_[l];
+        --queued_[l];
+        auto e = std::move(lanes_[l].front());
+        lanes_[l].pop_front();
+        return e;
+      }
+    }
+    if (std::all_of(begin(lanes_), end(lanes_),
+                    [](auto const& q) { return q.empty(); })) {
+      break;
+    }
+    credits_ = settings_.weights_;
+  }
+  return std::nullopt;
+}
+
+void lane_scheduler::run(entry e) {
+  try {
+    e.task_();
+  } catch (...) {
+    std::cerr << "lane_scheduler: unhandled error\n";
+  }
+
+  auto lock = std::unique_lock{mutex_};
+  --running_;
+  auto& r = *e.route_;
+  --r.admitted_;
+  if (!r.blocked_.empty()) {
+    ++r.admitted_;
+    lanes_[lane(r)].push_back({e.route_, std::move(r.blocked_.front())});
+    r.blocked_.pop_front();
+  }
+  schedule(lock);
+}
+
+void lane_scheduler::schedule(std::unique_lock<std::mutex>& lock) {
+  std::vector<entry> ready;
+  while (running_ < settings_.max_running_) {
+    auto e = next();
+    if (!e.has_value()) {
+      break;
+    }
+    ++running_;
+    ready.emplace_back(std::move(*e));
+  }
+  lock.unlock();
+
+  for (auto& e : ready) {
+    pool_.post([this, e = std::move(e)]() mutable { run(std::move(e)); });
+  }
+}
+
+}  // namespace net
@@ -0,0 +1,160 @@
+#include "net/web_server/timer_wheel.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+#include "boost/asio/dispatch.hpp"
+
+namespace asio = boost::asio;
+
+namespace net {
+
+timer_wheel::timer::~timer() { cancel(); }
+
+void timer_wheel::timer::cancel() {
+  if (shard_ != nullptr) {
+    auto const lock = std::lock_guard{shard_->mutex_};
+    hook_.unlink();
+    target_.reset();
+  }
+}
+
+timer_wheel::timer_wheel(asio::io_context& ioc,
+                         std::chrono::milliseconds const tick,
+                         std::size_t const n_shards)
+    : strand_{asio::make_strand(ioc)},
+      timer_{strand_},
+      tick_{tick},
+      start_{clock::now()} {
+  auto const n = n_shards != 0U
+                     ? n_shards
+                     : std::max(std::size_t{1U},
+                                static_cast<std::size_t>(
+                                    std::thread::hardware_concurrency()));
+  shards_.reserve(n);
+  for (auto i = 0U; i != n; ++i) {
+    shards_.emplace_back(std::make_unique<shard>());
+  }
+}
+
+void timer_wheel::start() {
+  if (!running_.exchange(true)) {
+    asio::dispatch(strand_, [this]() { schedule_tick(); });
+  }
+}
+
+void timer_wheel::stop() {
+  running_ = false;
+  asio::dispatch(strand_, [this]() { timer_.cancel(); });
+}
+
+void timer_wheel::arm(timer& t, std::weak_ptr<timeout_target> target,
+                      std::uint64_t const generation,
+                      std::chrono::nanoseconds const timeout) {
+  auto const ticks = static_cast<std::uint64_t>(
+      (timeout + tick_ - std::chrono::nanoseconds{1}) / tick_);
+  if (t.shard_ == nullptr) {
+    t.shard_ = &local_shard();
+  }
+  auto& s = *t.shard_;
+  auto const lock = std::lock_guard{s.mutex_};
+  t.hook_.unlink();
+  t.target_ = std::move(target);
+  t.generation_ = generation;
+  t.expiry_ = std::max(now_ticks() + ticks, s.current_);
+  s.insert(t);
+}
+
+void timer_wheel::schedule_tick() {
+  if (!running_) {
+    return;
+  }
+  timer_.expires_after(tick_);
+  timer_.async_wait([this](boost::system::error_code const ec) {
+    if (ec == asio::error::operation_aborted) {
+      return;
+    }
+    on_tick();
+    schedule_tick();
+  });
+}
+
+void timer_wheel::on_tick() {
+  auto const until = now_ticks();
+  auto expired = std::vector<expired_timer>{};
+  for (auto& s : shards_) {
+    auto const lock = std::lock_guard{s->mutex_};
+    s->advance(until, expired);
+  }
+
+  // Fire outside of the shard locks: targets may re-arm right away.
+  for (auto& e : expired) {
+    if (auto const target = e.target_.lock()) {
+      target->on_timeout(e.generation_);
+    }
+  }
+}
+
+std::uint64_t timer_wheel::now_ticks() const {
+  return static_cast<std::uint64_t>((clock::now() - start_) / tick_);
+}
+
+timer_wheel::shard& timer_wheel::local_shard() {
+  static std::atomic_size_t next_thread_idx{0U};
+  thread_local auto const thread_idx = next_thread_idx++;
+  return *shards_[thread_idx % shards_.size()];
+}
+
+void timer_wheel::shard::insert(timer& t) {
+  auto const delta = t.expiry_ - current_;
+  if (delta < kL0Slots) {
+    l0_[t.expiry_ & (kL0Slots - 1U)].push_back(t);
+  } else if (delta < kL0Slots * kL1Slots) {
+    l1_[(t.expiry_ >> kL0Bits) & (kL1Slots - 1U)].push_back(t);
+  } else {
+    overflow_.push_back(t);
+  }
+}
+
+void timer_wheel::shard::reinsert(slot_t& slot) {
+  auto pending = slot_t{};
+  pending.swap(slot);
+  while (!pending.empty()) {
+    auto& t = pending.front();
+    pending.pop_front();
+    insert(t);
+  }
+}
+
+void timer_wheel::shard::advance(std::uint64_t const until,
+                                 std::vector<expired_timer>& expired) {
+  for (; current_ <= until; ++current_) {
+    if ((current_ & (kL0Slots - 1U)) == 0U) {
+      // Level 0 wrapped: move the next level 1 slot (and on a level 1 wrap,
+      // the overflow list) down.
+      if (((current_ >> kL0Bits) & (kL1Slots - 1U)) == 0U) {
+        reinsert(overflow_);
+      }
+      reinsert(l1_[(current_ >> kL0Bits) & (kL1Slots - 1U)]);
+    }
+
+    auto& slot = l0_[current_ & (kL0Slots - 1U)];
+    if (slot.empty()) {
+      continue;
+    }
+    auto due = slot_t{};
+    due.swap(slot);
+    while (!due.empty()) {
+      auto& t = due.front();
+      due.pop_front();
+      if (t.expiry_ <= current_) {
+        expired.push_back({std::move(t.target_), t.generation_});
+      } else {
+        insert(t);
+      }
+    }
+  }
+}
+
+}  // namespace net
@@ -20,9 +20,13 @@ namespace net {
 struct web_server::impl {
 #if defined(NET_TLS)
   impl(asio::io_context& ioc, asio::ssl::context& ctx)
-      : ioc_{ioc}, acceptor_{ioc}, ctx_{ctx} {}
+      : ioc_{ioc}, acceptor_{ioc}, ctx_{ctx} {
+    settings_->timer_wheel_ = std::make_shared<timer_wheel>(ioc);
+  }
 #else
-  explicit impl(asio::io_context& ioc) : ioc_{ioc}, acceptor_{ioc} {}
+  explicit impl(asio::io_context& ioc) : ioc_{ioc}, acceptor_{ioc} {
+    settings_->timer_wheel_ = std::make_shared<timer_wheel>(ioc);
+  }
 #endif
 
   void on_http_request(http_req_cb_t cb) const {
@@ -74,14 +78,44 @@ struct web_server::impl {
 
   void run() {
     if (acceptor_.is_open()) {
+      settings_->timer_wheel_->start();
       do_accept();
     }
   }
 
-  void stop() { acceptor_.close(); }
+  void stop() {
+    acceptor_.close();
+    settings_->timer_wheel_->stop();
+  }
 
   void set_timeout(std::chrono::nanoseconds const& timeout) const {
     settings_->timeout_ = timeout;
+    settings_->idle_timeout_ = timeout;
+    settings_->header_timeout_ = timeout;
+    settings_->body_timeout_ = timeout;
+    settings_->write_timeout_ = timeout;
+  }
+
+  void set_idle_timeout(std::chrono::nanoseconds const& timeout) const {
+    settings_->idle_timeout_ = timeout;
+  }
+
+  void set_header_timeout(std::chrono::nanoseconds const& timeout) const {
+    settings_->header_timeout_ = timeout;
+  }
+
+  void set_body_timeout(std::chrono::nanoseconds const& timeout,
+                        std::uint64_t const min_bytes_per_second) const {
+    settings_->body_timeout_ = timeout;
+    settings_->body_min_rate_ = min_bytes_per_second;
+  }
+
+  void set_write_timeout(std::chrono::nanoseconds const& timeout) const {
+    settings_->write_timeout_ = timeout;
+  }
+
+  void set_max_requests_per_connection(std::size_t limit) const {
+    settings_->max_requests_per_connection_ = limit;
   }
 
   void set_request_body_limit(std::uint64_t limit) const {
@@ -92,6 +126,14 @@ struct web_server::impl {
     settings_->request_queue_limit_ = limit;
   }
 
+  void set_idle_buffer_limit(std::size_t limit) const {
+    settings_->idle_buffer_limit_ = limit;
+  }
+
+  void set_ws_subprotocols(std::vector<std::string> protocols) const {
+    settings_->ws_subprotocols_ = std::move(protocols);
+  }
+
   void do_accept() {
     acceptor_.async_accept(
         asio::make_strand(ioc_),
@@ -147,6 +189,30 @@ void web_server::set_timeout(std::chrono::nanoseconds const& timeout) const {
   impl_->set_timeout(timeout);
 }
 
+void web_server::set_idle_timeout(
+    std::chrono::nanoseconds const& timeout) const {
+  impl_->set_idle_timeout(timeout);
+}
+
+void web_server::set_header_timeout(
+    std::chrono::nanoseconds const& timeout) const {
+  impl_->set_header_timeout(timeout);
+}
+
+void web_server::set_body_timeout(std::chrono::nanoseconds const& timeout,
+                                  std::uint64_t min_bytes_per_second) const {
+  impl_->set_body_timeout(timeout, min_bytes_per_second);
+}
+
+void web_server::set_write_timeout(
+    std::chrono::nanoseconds const& timeout) const {
+  impl_->set_write_timeout(timeout);
+}
+
+void web_server::set_max_requests_per_connection(std::size_t limit) const {
+  impl_->set_max_requests_per_connection(limit);
+}
+
 void web_server::set_request_body_limit(std::uint64_t limit) const {
   impl_->set_request_body_limit(limit);
 }
@@ -155,6 +221,15 @@ void web_server::set_request_queue_limit(std::size_t limit) const {
   impl_->set_request_queue_limit(limit);
 }
 
+void web_server::set_idle_buffer_limit(std::size_t limit) const {
+  impl_->set_idle_buffer_limit(limit);
+}
+
+void web_server::set_ws_subprotocols(
+    std::vector<std::string> protocols) const {
+  impl_->set_ws_subprotocols(std::move(protocols));
+}
+
 void web_server::on_http_request(http_req_cb_t cb) const {
   impl_->on_http_request(std::move(cb));
 }
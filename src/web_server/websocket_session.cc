@@ -1,19 +1,49 @@
 #include "net/web_server/websocket_session.h"
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <queue>
+#include <string>
+#include <string_view>
 #include <utility>
 
+#include "boost/asio/dispatch.hpp"
 #include "boost/beast/core/bind_handler.hpp"
 #include "boost/beast/core/buffers_to_string.hpp"
 #include "boost/beast/version.hpp"
 #include "boost/beast/websocket.hpp"
 
+#include "net/mpsc_queue.h"
+#include "net/web_server/compact_buffer.h"
 #include "net/web_server/fail.h"
 #include "net/web_server/web_server.h"
 
 namespace net {
 
+std::string select_subprotocol(
+    boost::beast::http::request<boost::beast::http::string_body> const& req,
+    std::vector<std::string> const& supported) {
+  auto const header = req[boost::beast::http::field::sec_websocket_protocol];
+  auto offered = std::string_view{header.data(), header.size()};
+  while (!offered.empty()) {
+    auto const comma = offered.find(',');
+    auto p = offered.substr(0U, comma);
+    offered.remove_prefix(comma == std::string_view::npos ? offered.size()
+                                                          : comma + 1U);
+    while (!p.empty() && (p.front() == ' ' || p.front() == '\t')) {
+      p.remove_prefix(1U);
+    }
+    while (!p.empty() && (p.back() == ' ' || p.back() == '\t')) {
+      p.remove_suffix(1U);
+    }
+    if (std::find(begin(supported), end(supported), p) != end(supported)) {
+      return std::string{p};
+    }
+  }
+  return {};
+}
+
 template <class Derived>
 struct websocket_session : public ws_session {
   using send_cb_t = std::function<void(boost::system::error_code, std::size_t)>;
@@ -49,9 +79,16 @@ struct websocket_session : public ws_session {
     on_msg_ = std::move(fn);
   }
 
+  // Safe to call from any thread: messages are pushed to a lock-free inbox
+  // which is drained on the session's strand. Only the first push after a
+  // drain schedules a new one.
   void send(std::string msg, ws_msg_type type, send_cb_t cb) override {
-    send_queue_.emplace(std::move(msg), type, cb);
-    send_next();
+    inbox_.push(send_entry_t{std::move(msg), type, std::move(cb)});
+    if (!drain_scheduled_.exchange(true)) {
+      boost::asio::dispatch(
+          derived().ws().get_executor(),
+          [self = derived().shared_from_this()]() { self->drain_inbox(); });
+    }
   }
 
 private:
@@ -64,10 +101,16 @@ private:
             boost::beast::role_type::server));
 
     // Set a decorator to change the Server of the handshake
+    // and to confirm the negotiated subprotocol.
     derived().ws().set_option(boost::beast::websocket::stream_base::decorator(
-        [](boost::beast::websocket::response_type& res) {
+        [protocol = select_subprotocol(req, settings_->ws_subprotocols_)](
+            boost::beast::websocket::response_type& res) {
           res.set(boost::beast::http::field::server,
                   std::string(BOOST_BEAST_VERSION_STRING));
+          if (!protocol.empty()) {
+            res.set(boost::beast::http::field::sec_websocket_protocol,
+                    protocol);
+          }
         }));
 
     // Accept the websocket handshake
@@ -125,6 +168,7 @@ private:
     }
 
     buffer_.consume(buffer_.size());
+    compact_buffer(buffer_, settings_->idle_buffer_limit_);
     do_read();
   }
 
@@ -139,6 +183,16 @@ private:
     buffer_.consume(buffer_.size());
   }
 
+  void drain_inbox() {
+    // Reset before draining: a producer that observes `false` afterwards
+    // schedules another drain, so no message is left behind.
+    drain_scheduled_ = false;
+    while (auto entry = inbox_.pop()) {
+      send_queue_.emplace(std::move(*entry));
+    }
+    send_next();
+  }
+
   void send_next() {
     if (send_active_ || send_queue_.empty()) {
       return;
@@ -174,7 +228,10 @@ private:
 
   web_server_settings_ptr settings_;
 
-  std::queue<std::tuple<std::string, ws_msg_type, send_cb_t>> send_queue_;
+  using send_entry_t = std::tuple<std::string, ws_msg_type, send_cb_t>;
+  mpsc_queue<send_entry_t> inbox_;
+  std::atomic_bool drain_scheduled_{false};
+  std::queue<send_entry_t> send_queue_;
   bool send_active_{false};
 
   std::function<void()> on_close_;
@@ -0,0 +1,144 @@
+#include "net/web_server/work_stealing_pool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace net {
+
+namespace {
+
+// Set on worker threads: tasks they post stay in their own deque.
+thread_local work_stealing_pool const* current_pool = nullptr;
+thread_local std::size_t current_worker = 0U;
+
+}  // namespace
+
+work_stealing_pool::work_stealing_pool(std::size_t const n_threads) {
+  auto const n = n_threads != 0U
+                     ? n_threads
+                     : std::max(std::size_t{1U},
+                                static_cast<std::size_t>(
+                                    std::thread::hardware_concurrency()));
+  workers_.reserve(n);
+  for (auto i = 0U; i != n; ++i) {
+    workers_.emplace_back(std::make_unique<worker>());
+  }
+  for (auto i = 0U; i != n; ++i) {
+    workers_[i]->thread_ = std::thread{[this, i]() { run(i); }};
+  }
+}
+
+work_stealing_pool::~work_stealing_pool() { stop(); }
+
+void work_stealing_pool::post(task_t task) {
+  if (current_pool == this) {
+    auto& w = *workers_[current_worker];
+    auto const lock = std::lock_guard{w.mutex_};
+    w.tasks_.emplace_back(std::move(task));
+    ++pending_;
+  } else {
+    auto const lock = std::lock_guard{inject_mutex_};
+    injected_.emplace_back(std::move(task));
+    ++pending_;
+  }
+
+  if (sleeping_ != 0U) {
+    { auto const lock = std::lock_guard{sleep_mutex_}; }
+    wakeup_.notify_one();
+  }
+}
+
+void work_stealing_pool::stop() {
+  if (current_pool == this) {
+    throw std::logic_error{"work_stealing_pool: stop() on a worker thread"};
+  }
+  {
+    auto const lock = std::lock_guard{sleep_mutex_};
+    stop_ = true;
+  }
+  wakeup_.notify_all();
+  for (auto& w : workers_) {
+    if (w->thread_.joinable()) {
+      w->thread_.join();
+    }
+  }
+}
+
+void work_stealing_pool::run(std::size_t const id) {
+  current_pool = this;
+  current_worker = id;
+
+  while (true) {
+    auto task = pop(id);
+    if (!task.has_value()) {
+      task = pop_injected();
+    }
+    if (!task.has_value()) {
+      task = steal(id);
+    }
+
+    if (task.has_value()) {
+      try {
+        (*task)();
+      } catch (std::exception const& e) {
+        std::cerr << "work_stealing_pool: unhandled error: " << e.what()
+                  << "\n";
+      } catch (...) {
+        std::cerr << "work_stealing_pool: unhandled unknown error\n";
+      }
+      continue;
+    }
+
+    auto lock = std::unique_lock{sleep_mutex_};
+    ++sleeping_;
+    wakeup_.wait(lock, [&]() { return pending_ != 0U || stop_; });
+    --sleeping_;
+    if (stop_ && pending_ == 0U) {
+      break;
+    }
+  }
+}
+
+std::optional<work_stealing_pool::task_t> work_stealing_pool::pop(
+    std::size_t const id) {
+  auto& w = *workers_[id];
+  auto const lock = std::lock_guard{w.mutex_};
+  if (w.tasks_.empty()) {
+    return std::nullopt;
+  }
+  auto task = std::move(w.tasks_.back());
+  w.tasks_.pop_back();
+  --pending_;
+  return task;
+}
+
+std::optional<work_stealing_pool::task_t> work_stealing_pool::pop_injected() {
+  auto const lock = std::lock_guard{inject_mutex_};
+  if (injected_.empty()) {
+    return std::nullopt;
+  }
+  auto task = std::move(injected_.front());
+  injected_.pop_front();
+  --pending_;
+  return task;
+}
+
+std::optional<work_stealing_pool::task_t> work_stealing_pool::steal(
+    std::size_t const id) {
+  for (auto i = std::size_t{1U}; i != workers_.size(); ++i) {
+    auto& w = *workers_[(id + i) % workers_.size()];
+    auto const lock = std::unique_lock{w.mutex_, std::try_to_lock};
+    if (!lock.owns_lock() || w.tasks_.empty()) {
+      continue;
+    }
+    auto task = std::move(w.tasks_.front());
+    w.tasks_.pop_front();
+    --pending_;
+    return task;
+  }
+  return std::nullopt;
+}
+
+}  // namespace net